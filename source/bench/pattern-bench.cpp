@@ -0,0 +1,59 @@
+// Compares text::pattern against std::regex on directory and file names like the ones we crawl.
+// Build with -DH5MBL_BUILD_BENCH=ON and run ./pattern-bench [num_names]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <general/pattern.h>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace {
+    template<typename Func>
+    void bench(const char *label, const std::vector<std::string> &names, Func &&func) {
+        size_t count = 0;
+        auto   t0    = std::chrono::steady_clock::now();
+        for(const auto &name : names) count += func(name) ? 1 : 0;
+        auto t1 = std::chrono::steady_clock::now();
+        auto ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+        std::printf("%-40s %8zu matches %10.1f ns/name\n", label, count, ns / static_cast<double>(names.size()));
+    }
+}
+
+int main(int argc, char *argv[]) {
+    size_t num_names = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+
+    std::vector<std::string> names;
+    names.reserve(num_names);
+    for(size_t i = 0; i < num_names; i++) {
+        auto L = 12 + 4 * (i % 4);
+        names.emplace_back("/data/mbl_" + std::to_string(i % 7) + "/L_" + std::to_string(L) + "/x_" + std::to_string(i % 5) + "/mbl_" +
+                           std::to_string(1000000 + i) + ".h5");
+    }
+
+    struct Case {
+        const char *regex;
+        const char *glob;
+    };
+    std::vector<Case> cases = {
+        {".*/mbl_[0-9]+\\.h5", "*/mbl_[0-9]*.h5"},
+        {".*L_(16|24).*", "*L_{16,24}*"},
+        {"/data/mbl_3.*", "/data/mbl_3*"},
+    };
+    for(const auto &c : cases) {
+        std::regex    reg(c.regex);
+        text::pattern rpat(c.regex, text::pattern::syntax::regex);
+        text::pattern gpat(c.glob, text::pattern::syntax::glob);
+        std::printf("%s | %s\n", c.regex, c.glob);
+        bench("  std::regex_match", names, [&](const std::string &n) { return std::regex_match(n, reg); });
+        bench("  text::pattern (regex)", names, [&](const std::string &n) { return rpat.match(n); });
+        bench("  text::pattern (glob)", names, [&](const std::string &n) { return gpat.match(n); });
+    }
+
+    // Substring filters, as in --inc/--exc
+    std::regex    reg("L_16");
+    text::pattern pat("L_16");
+    std::printf("L_16 (substring)\n");
+    bench("  std::regex_search", names, [&](const std::string &n) { return std::regex_search(n, reg); });
+    bench("  text::pattern::search", names, [&](const std::string &n) { return pat.search(n); });
+}
@@ -3,6 +3,7 @@
 #include <string_view>
 enum class FileIdStatus { UPTODATE, STALE, MISSING };
 enum class Model {SDUAL, LBIT};
+enum class Schedule { STATIC, DYNAMIC };
 template<typename T>
 constexpr std::string_view enum2str(const T &item) {
     if constexpr(std::is_same_v<T, FileIdStatus>) {
@@ -14,6 +15,10 @@ constexpr std::string_view enum2str(const T &item) {
         if(item == Model::SDUAL) return "SDUAL";
         if(item == Model::LBIT)  return "LBIT";
     }
+    if constexpr(std::is_same_v<T, Schedule>) {
+        if(item == Schedule::STATIC) return "STATIC";
+        if(item == Schedule::DYNAMIC) return "DYNAMIC";
+    }
     throw std::runtime_error("Given invalid enum item");
 }
 
@@ -37,5 +42,11 @@ constexpr auto str2enum(std::string_view item) {
         if(item == "f-lbit")  return Model::LBIT;
         if(item == "FLBIT")  return Model::LBIT;
     }
+    if constexpr(std::is_same_v<T, Schedule>) {
+        if(item == "static") return Schedule::STATIC;
+        if(item == "STATIC") return Schedule::STATIC;
+        if(item == "dynamic") return Schedule::DYNAMIC;
+        if(item == "DYNAMIC") return Schedule::DYNAMIC;
+    }
     throw std::runtime_error("str2enum given invalid string item: " + std::string(item));
 }
\ No newline at end of file
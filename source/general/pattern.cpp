@@ -0,0 +1,448 @@
+#include "pattern.h"
+#include <algorithm>
+#include <cctype>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <utility>
+
+namespace text {
+    /*! \brief Thompson construction of the NFA in a pattern. Throws on syntax it does not support */
+    class pattern_compiler {
+        using node = pattern::node;
+        using op   = pattern::op;
+        struct frag {
+            int                               start = -1;
+            std::vector<std::pair<int, bool>> outs; // Dangling edges: (node, true if it is the alt edge)
+        };
+
+        std::vector<node> &nodes;
+        std::string_view   pat;
+        size_t             pos = 0;
+
+        [[nodiscard]] bool at_end() const { return pos >= pat.size(); }
+        [[nodiscard]] char peek() const { return pat[pos]; }
+        [[noreturn]] void  unsupported() const { throw std::runtime_error("unsupported pattern syntax"); }
+
+        int add(op type, std::bitset<256> chars = {}) {
+            nodes.push_back(node{type, chars, -1, -1});
+            return static_cast<int>(nodes.size() - 1);
+        }
+        void patch(const frag &f, int target) {
+            for(const auto &[id, is_alt] : f.outs) (is_alt ? nodes[static_cast<size_t>(id)].alt : nodes[static_cast<size_t>(id)].out) = target;
+        }
+        frag chars(std::bitset<256> set) {
+            auto id = add(op::chars, set);
+            return {id, {{id, false}}};
+        }
+        frag epsilon() {
+            auto id = add(op::split);
+            return {id, {{id, false}}};
+        }
+        frag concat(frag a, const frag &b) {
+            patch(a, b.start);
+            return {a.start, b.outs};
+        }
+        frag either(const frag &a, const frag &b) {
+            auto id                            = add(op::split);
+            nodes[static_cast<size_t>(id)].out = a.start;
+            nodes[static_cast<size_t>(id)].alt = b.start;
+            frag f{id, a.outs};
+            f.outs.insert(f.outs.end(), b.outs.begin(), b.outs.end());
+            return f;
+        }
+        frag star(const frag &a) {
+            auto id                            = add(op::split);
+            nodes[static_cast<size_t>(id)].out = a.start;
+            patch(a, id);
+            return {id, {{id, true}}};
+        }
+        frag plus(const frag &a) {
+            auto id                            = add(op::split);
+            nodes[static_cast<size_t>(id)].out = a.start;
+            patch(a, id);
+            return {a.start, {{id, true}}};
+        }
+        frag optional(frag a) {
+            auto id                            = add(op::split);
+            nodes[static_cast<size_t>(id)].out = a.start;
+            a.outs.emplace_back(id, true);
+            return {id, a.outs};
+        }
+
+        static std::bitset<256> single(char c) {
+            std::bitset<256> set;
+            set.set(static_cast<unsigned char>(c));
+            return set;
+        }
+        static std::bitset<256> any() { return std::bitset<256>().set(); }
+
+        std::bitset<256> escape_class(char c) {
+            std::bitset<256> set;
+            auto             range = [&set](int lo, int hi) {
+                for(int i = lo; i <= hi; i++) set.set(static_cast<size_t>(i));
+            };
+            switch(c) {
+                case 'd': range('0', '9'); return set;
+                case 'D': range('0', '9'); return set.flip();
+                case 'w':
+                    range('0', '9'), range('a', 'z'), range('A', 'Z'), set.set('_');
+                    return set;
+                case 'W':
+                    range('0', '9'), range('a', 'z'), range('A', 'Z'), set.set('_');
+                    return set.flip();
+                case 's':
+                    for(char ws : std::string_view(" \t\n\r\f\v")) set.set(static_cast<unsigned char>(ws));
+                    return set;
+                case 'S':
+                    for(char ws : std::string_view(" \t\n\r\f\v")) set.set(static_cast<unsigned char>(ws));
+                    return set.flip();
+                default:
+                    // Escaped punctuation is literal. Letters and digits are escapes (\b, \1 ...) we do not support
+                    if(std::isalnum(static_cast<unsigned char>(c)) != 0) unsupported();
+                    return single(c);
+            }
+        }
+
+        std::bitset<256> bracket(bool glob) {
+            // At the character after '['
+            std::bitset<256> set;
+            bool             negate = false;
+            if(not at_end() and (peek() == '^' or (glob and peek() == '!'))) {
+                negate = true;
+                pos++;
+            }
+            bool first = true;
+            while(true) {
+                if(at_end()) unsupported();
+                char c = pat[pos++];
+                if(c == ']' and not first) break;
+                first = false;
+                if(c == '[') unsupported(); // [:alpha:] and friends
+                if(c == '\\') {
+                    if(at_end()) unsupported();
+                    c = pat[pos++];
+                    if(not glob and std::isalpha(static_cast<unsigned char>(c)) != 0) {
+                        set |= escape_class(c);
+                        continue;
+                    }
+                }
+                if(pos + 1 < pat.size() and peek() == '-' and pat[pos + 1] != ']') {
+                    char hi = pat[pos + 1];
+                    if(hi == '\\' or hi == '[') unsupported();
+                    pos += 2;
+                    if(static_cast<unsigned char>(hi) < static_cast<unsigned char>(c)) unsupported();
+                    for(int i = static_cast<unsigned char>(c); i <= static_cast<unsigned char>(hi); i++) set.set(static_cast<size_t>(i));
+                } else {
+                    set.set(static_cast<unsigned char>(c));
+                }
+            }
+            return negate ? set.flip() : set;
+        }
+
+        // Regex: alternation := sequence ('|' sequence)*
+        frag regex_alternation() {
+            auto f = regex_sequence();
+            while(not at_end() and peek() == '|') {
+                pos++;
+                f = either(f, regex_sequence());
+            }
+            return f;
+        }
+        frag regex_sequence() {
+            std::optional<frag> f;
+            while(not at_end() and peek() != '|' and peek() != ')') {
+                auto atom = regex_repeat();
+                f         = f ? concat(*f, atom) : atom;
+            }
+            return f ? *f : epsilon();
+        }
+        frag regex_repeat() {
+            auto f = regex_atom();
+            if(at_end()) return f;
+            switch(peek()) {
+                case '*': f = star(f); break;
+                case '+': f = plus(f); break;
+                case '?': f = optional(f); break;
+                case '{': unsupported();
+                default: return f;
+            }
+            pos++;
+            if(not at_end() and peek() == '?') pos++; // Lazy quantifiers match the same strings
+            return f;
+        }
+        frag regex_atom() {
+            char c = pat[pos++];
+            switch(c) {
+                case '(': {
+                    if(not at_end() and peek() == '?') {
+                        if(pos + 1 >= pat.size() or pat[pos + 1] != ':') unsupported(); // Lookaheads
+                        pos += 2;
+                    }
+                    auto f = regex_alternation();
+                    if(at_end() or peek() != ')') unsupported();
+                    pos++;
+                    return f;
+                }
+                case '.': return chars(any().reset('\n').reset('\r'));
+                case '[': return chars(bracket(false));
+                case '\\':
+                    if(at_end()) unsupported();
+                    return chars(escape_class(pat[pos++]));
+                case '*':
+                case '+':
+                case '?':
+                case '{':
+                case '}':
+                case ')':
+                case '^': // Anchors are left to std::regex, since they matter to search()
+                case '$': unsupported();
+                default: return chars(single(c));
+            }
+        }
+
+        // Glob: alternation := sequence (',' sequence)* inside braces
+        frag glob_sequence(bool in_braces) {
+            std::optional<frag> f;
+            while(not at_end()) {
+                char c = peek();
+                if(in_braces and (c == ',' or c == '}')) break;
+                pos++;
+                frag atom;
+                switch(c) {
+                    case '*': atom = star(chars(any())); break;
+                    case '?': atom = chars(any()); break;
+                    case '[': atom = chars(bracket(true)); break;
+                    case '{': {
+                        atom = glob_sequence(true);
+                        while(not at_end() and peek() == ',') {
+                            pos++;
+                            atom = either(atom, glob_sequence(true));
+                        }
+                        if(at_end() or peek() != '}') unsupported();
+                        pos++;
+                        break;
+                    }
+                    case '\\':
+                        if(at_end()) unsupported();
+                        atom = chars(single(pat[pos++]));
+                        break;
+                    default: atom = chars(single(c));
+                }
+                f = f ? concat(*f, atom) : atom;
+            }
+            return f ? *f : epsilon();
+        }
+
+        public:
+        pattern_compiler(std::vector<node> &nodes_, std::string_view pat_) : nodes(nodes_), pat(pat_) {}
+        int compile(pattern::syntax syn) {
+            auto f = syn == pattern::syntax::glob ? glob_sequence(false) : regex_alternation();
+            if(not at_end()) unsupported(); // A stray ')'
+            auto accept = add(op::accept);
+            patch(f, accept);
+            return f.start;
+        }
+    };
+
+    namespace internal {
+        bool is_literal(std::string_view str, pattern::syntax syn) {
+            constexpr std::string_view glob_meta  = "*?[]{},\\";
+            constexpr std::string_view regex_meta = ".*+?[](){}|^$\\";
+            return str.find_first_of(syn == pattern::syntax::glob ? glob_meta : regex_meta) == std::string_view::npos;
+        }
+    }
+
+    pattern::pattern(std::string_view pat, syntax syn) : source(pat) {
+        // Most of our patterns are names, or name prefixes, which do not need an NFA
+        std::string_view wildcard = syn == syntax::glob ? "*" : ".*";
+        if(internal::is_literal(pat, syn)) {
+            type    = kind::literal;
+            literal = pat;
+            return;
+        }
+        if(pat.size() >= wildcard.size() and pat.substr(pat.size() - wildcard.size()) == wildcard and
+           internal::is_literal(pat.substr(0, pat.size() - wildcard.size()), syn)) {
+            type    = kind::prefix;
+            literal = pat.substr(0, pat.size() - wildcard.size());
+            return;
+        }
+        try {
+            start = pattern_compiler(nodes, pat).compile(syn);
+            type  = kind::nfa;
+        } catch(const std::runtime_error &) {
+            if(syn == syntax::glob) throw std::runtime_error("Invalid glob pattern: " + source);
+            nodes.clear();
+            type     = kind::fallback;
+            fallback = std::regex(source); // Throws std::regex_error on invalid patterns, like before
+            return;
+        }
+
+        // Bytes that every node treats the same share a class, which keeps the DFA tables small
+        std::map<std::vector<bool>, std::uint8_t> signatures;
+        for(size_t b = 0; b < 256; b++) {
+            std::vector<bool> signature;
+            signature.reserve(nodes.size());
+            for(const auto &n : nodes) signature.push_back(n.type == op::chars and n.chars.test(b));
+            classes[b] = signatures.try_emplace(signature, static_cast<std::uint8_t>(signatures.size())).first->second;
+        }
+        num_classes = signatures.size();
+        build_dfa(dfa_match, false);
+        build_dfa(dfa_search, true);
+    }
+
+    void pattern::closure(std::vector<int> &list, std::vector<bool> &seen, int id, bool &accepted) const {
+        // Adds id and the states reachable from it without consuming a character
+        if(id < 0 or seen[static_cast<size_t>(id)]) return;
+        seen[static_cast<size_t>(id)] = true;
+        const auto &n                 = nodes[static_cast<size_t>(id)];
+        switch(n.type) {
+            case op::split:
+                closure(list, seen, n.out, accepted);
+                closure(list, seen, n.alt, accepted);
+                break;
+            case op::accept: accepted = true; break;
+            case op::chars: list.push_back(id); break;
+        }
+    }
+
+    void pattern::build_dfa(dfa &d, bool anywhere) {
+        // Subset construction. Each DFA state is the sorted list of NFA character nodes that are alive, and whether it accepts
+        constexpr size_t                max_states = 256;
+        std::map<std::vector<int>, int> index;
+        std::vector<std::vector<int>>   states;
+        auto                            add_state  = [&](std::vector<int> list, bool accepted) {
+            std::sort(list.begin(), list.end());
+            if(accepted) list.push_back(-1); // Reaching accept in different steps gives different states with the same list
+            auto [it, is_new] = index.try_emplace(list, static_cast<int>(states.size()));
+            if(is_new) {
+                states.emplace_back(std::move(list));
+                d.accept.push_back(accepted);
+                d.next.resize(states.size() * num_classes, -1);
+            }
+            return it->second;
+        };
+        std::vector<int>  list;
+        std::vector<bool> seen(nodes.size(), false);
+        bool              accepted = false;
+        closure(list, seen, start, accepted);
+        add_state(list, accepted);
+
+        // One representative byte per class
+        std::vector<unsigned char> representative(num_classes);
+        for(size_t b = 256; b-- > 0;) representative[classes[b]] = static_cast<unsigned char>(b);
+
+        for(size_t s = 0; s < states.size(); s++) {
+            for(size_t cls = 0; cls < num_classes; cls++) {
+                list.clear();
+                seen.assign(nodes.size(), false);
+                accepted = false;
+                for(const auto &id : states[s]) {
+                    if(id < 0) continue;
+                    const auto &n = nodes[static_cast<size_t>(id)];
+                    if(n.chars.test(representative[cls])) closure(list, seen, n.out, accepted);
+                }
+                if(anywhere) closure(list, seen, start, accepted);
+                if(list.empty() and not accepted) continue; // Dead
+                auto next = add_state(list, accepted);
+                if(states.size() > max_states) {
+                    d = dfa{}; // Too large: simulate the NFA instead
+                    return;
+                }
+                d.next[s * num_classes + cls] = next;
+            }
+        }
+        d.ok = true;
+    }
+
+    bool pattern::run(std::string_view str, bool anywhere) const {
+        // Simulates the NFA on all states at once, so the time is linear in the length of str
+        thread_local std::vector<int>    curr, next, stack;
+        thread_local std::vector<size_t> mark;
+        thread_local size_t              generation = 0;
+        if(mark.size() < nodes.size()) mark.resize(nodes.size(), std::numeric_limits<size_t>::max());
+        bool accepted = false;
+        auto follow   = [&](std::vector<int> &list, int id) {
+            // Adds id and the states reachable from it without consuming a character
+            stack.clear();
+            stack.push_back(id);
+            while(not stack.empty()) {
+                auto s = stack.back();
+                stack.pop_back();
+                if(s < 0 or mark[static_cast<size_t>(s)] == generation) continue;
+                mark[static_cast<size_t>(s)] = generation;
+                const auto &n                = nodes[static_cast<size_t>(s)];
+                switch(n.type) {
+                    case op::split:
+                        stack.push_back(n.alt);
+                        stack.push_back(n.out);
+                        break;
+                    case op::accept: accepted = true; break;
+                    case op::chars: list.push_back(s); break;
+                }
+            }
+        };
+        curr.clear();
+        generation++;
+        follow(curr, start);
+        for(const auto &c : str) {
+            if(anywhere and accepted) return true;
+            accepted = false;
+            generation++;
+            next.clear();
+            for(const auto &s : curr) {
+                const auto &n = nodes[static_cast<size_t>(s)];
+                if(n.chars.test(static_cast<unsigned char>(c))) follow(next, n.out);
+            }
+            if(anywhere) follow(next, start);
+            std::swap(curr, next);
+            if(curr.empty() and not accepted) return false;
+        }
+        return accepted;
+    }
+
+    bool pattern::match(std::string_view str) const {
+        switch(type) {
+            case kind::literal: return str == literal;
+            case kind::prefix: return str.substr(0, literal.size()) == literal;
+            case kind::nfa: {
+                if(not dfa_match.ok) return run(str, false);
+                int state = 0;
+                for(const auto &c : str) {
+                    state = dfa_match.next[static_cast<size_t>(state) * num_classes + classes[static_cast<unsigned char>(c)]];
+                    if(state < 0) return false;
+                }
+                return dfa_match.accept[static_cast<size_t>(state)];
+            }
+            case kind::fallback: return std::regex_match(str.begin(), str.end(), *fallback);
+        }
+        return false;
+    }
+
+    bool pattern::search(std::string_view str) const {
+        switch(type) {
+            case kind::literal:
+            case kind::prefix: return str.find(literal) != std::string_view::npos;
+            case kind::nfa: {
+                if(not dfa_search.ok) return run(str, true);
+                int state = 0;
+                for(const auto &c : str) {
+                    if(dfa_search.accept[static_cast<size_t>(state)]) return true;
+                    state = dfa_search.next[static_cast<size_t>(state) * num_classes + classes[static_cast<unsigned char>(c)]];
+                    if(state < 0) return false;
+                }
+                return dfa_search.accept[static_cast<size_t>(state)];
+            }
+            case kind::fallback: return std::regex_search(str.begin(), str.end(), *fallback);
+        }
+        return false;
+    }
+
+    const pattern &pattern::cached(std::string_view pat, syntax syn) {
+        thread_local std::map<std::pair<syntax, std::string>, pattern, std::less<>> cache;
+        auto key = std::make_pair(syn, std::string(pat));
+        auto it  = cache.find(key);
+        if(it == cache.end()) it = cache.emplace(key, pattern(pat, syn)).first;
+        return it->second;
+    }
+}
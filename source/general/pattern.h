@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <optional>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace text {
+    /*! \brief A name pattern compiled once into a small NFA, for matching many names quickly
+     *
+     * Two syntaxes are understood:
+     *  - glob:  `*`, `?`, classes `[a-z]` / `[!a-z]`, alternations `{a,b}` and escapes `\*`.
+     *  - regex: the subset of ECMAScript we use in practice: `.`, `*`, `+`, `?`, classes, groups `(a|b)`, alternations and escapes.
+     *           Anything else (e.g. `{m,n}` or backreferences) falls back to std::regex, so the result is always the same as std::regex_match.
+     * The NFA is turned into a DFA up front, unless that takes too many states, so matching is one table lookup per character.
+     * Plain literals and literal prefixes (`abc*` or `abc.*`) skip the automaton entirely.
+     * Matching needs no locks and allocates nothing after warmup, so a pattern can be shared between threads.
+     */
+    class pattern {
+        public:
+        enum class syntax { glob, regex };
+
+        explicit pattern(std::string_view pat, syntax syn = syntax::glob);
+        [[nodiscard]] bool               match(std::string_view str) const;  /*!< True if the whole of str matches */
+        [[nodiscard]] bool               search(std::string_view str) const; /*!< True if any substring of str matches */
+        [[nodiscard]] const std::string &str() const { return source; }
+
+        static const pattern &cached(std::string_view pat, syntax syn = syntax::glob); /*!< Compiles pat once per thread */
+
+        private:
+        enum class kind { literal, prefix, nfa, fallback };
+        enum class op { chars, split, accept };
+        struct node {
+            op               type = op::split;
+            std::bitset<256> chars;    // The characters accepted by an op::chars node
+            int              out = -1; // Next node
+            int              alt = -1; // Second branch of an op::split node, if any
+        };
+        struct dfa {
+            std::vector<int>  next;   // Transitions: next[state * num_classes + class], or -1 when no match is possible
+            std::vector<bool> accept; // Accepting states
+            bool              ok = false;
+        };
+        std::string                   source;
+        kind                          type = kind::nfa;
+        std::string                   literal; // The literal, or the prefix
+        std::vector<node>             nodes;
+        int                           start = -1;
+        std::array<std::uint8_t, 256> classes{}; // Bytes that no node tells apart share a class
+        size_t                        num_classes = 0;
+        dfa                           dfa_match, dfa_search; // Start state 0. For search the start state is re-entered at every character
+        std::optional<std::regex>     fallback;
+
+        friend class pattern_compiler;
+        void               build_dfa(dfa &d, bool anywhere);
+        void               closure(std::vector<int> &list, std::vector<bool> &seen, int id, bool &accepted) const;
+        [[nodiscard]] bool run(std::string_view str, bool anywhere) const;
+    };
+}
@@ -0,0 +1,84 @@
+#include "concurrency.h"
+#include <algorithm>
+#include <general/human.h>
+#include <io/logger.h>
+#include <vector>
+
+namespace tools::io {
+    double concurrency::Window::fastest() const {
+        double result = -1;
+        for(const auto &s : samples)
+            if(result < 0 or s.pace < result) result = s.pace;
+        return result;
+    }
+
+    double concurrency::Window::percentile(double p) const {
+        if(samples.empty()) return 0;
+        std::vector<double> seconds;
+        seconds.reserve(samples.size());
+        for(const auto &s : samples) seconds.emplace_back(s.seconds);
+        auto nth = seconds.begin() + static_cast<std::ptrdiff_t>(std::clamp(p, 0.0, 1.0) * static_cast<double>(seconds.size() - 1));
+        std::nth_element(seconds.begin(), nth, seconds.end());
+        return *nth;
+    }
+
+    double concurrency::Window::throughput() const {
+        // The reads overlap, so divide by the wall time they span rather than by the sum of their latencies
+        if(samples.empty()) return 0;
+        uintmax_t bytes = 0;
+        auto      first = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(samples.front().seconds));
+        auto      begin = samples.front().time - first;
+        for(const auto &s : samples) bytes += s.bytes;
+        auto span = std::chrono::duration<double>(samples.back().time - begin).count();
+        return span > 0 ? static_cast<double>(bytes) / span : 0;
+    }
+
+    concurrency::concurrency(size_t min_limit_, size_t max_limit_)
+        : min_limit(std::max<size_t>(min_limit_, 1)), max_limit(std::max(std::max<size_t>(min_limit_, 1), max_limit_)) {
+        limit = static_cast<double>(min_limit);
+    }
+
+    void concurrency::report(op kind, double seconds, uintmax_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto                       &window  = kind == op::open ? opens : reads;
+        auto                        fastest = window.fastest();
+        auto                        floored = std::max(seconds, slow_min); // A page cache hit of zero seconds would make every later file look slow
+        auto                        pace    = kind == op::open ? floored : floored / static_cast<double>(std::max(bytes, read_min_bytes));
+        window.samples.push_back({seconds, bytes, pace, std::chrono::steady_clock::now()});
+        if(window.samples.size() > window_size) window.samples.pop_front();
+        since_decrease++;
+        if(fastest < 0) return; // Nothing to compare with yet
+        if(pace > slow_factor * fastest and seconds > slow_min) {
+            // Only once per round: the other reads in flight were slowed down by the same congestion
+            if(since_decrease >= static_cast<size_t>(limit)) {
+                limit          = std::max(limit / 2, static_cast<double>(min_limit));
+                since_decrease = 0;
+                num_decrease++;
+            }
+        } else {
+            limit = std::min(limit + 1.0 / limit, static_cast<double>(max_limit));
+        }
+    }
+
+    size_t concurrency::get_limit() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return static_cast<size_t>(limit);
+    }
+
+    double concurrency::percentile(op kind, double p) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return (kind == op::open ? opens : reads).percentile(p);
+    }
+
+    std::string concurrency::summary() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto        ms     = [](double seconds) { return 1000.0 * seconds; };
+        std::string result = fmt::format("io limit {}/{} (-{})", static_cast<size_t>(limit), max_limit, num_decrease);
+        if(not opens.samples.empty())
+            result += fmt::format(" | open p50 {:.1f} p95 {:.1f} ms", ms(opens.percentile(0.50)), ms(opens.percentile(0.95)));
+        if(not reads.samples.empty())
+            result += fmt::format(" | read p50 {:.1f} p95 {:.1f} ms {}/s", ms(reads.percentile(0.50)), ms(reads.percentile(0.95)),
+                                  tools::fmtBytes(true, static_cast<size_t>(reads.throughput()), 1024, 1));
+        return result;
+    }
+}
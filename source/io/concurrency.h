@@ -0,0 +1,60 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+
+namespace tools::io {
+    /*! \brief Limits the number of source reads in flight, adapting to the latency of the filesystem (AIMD)
+     *
+     * Every open and read of a source file reports its latency and size. The limit then changes like the congestion window of TCP:
+     *  - Additive increase: it grows by one after about limit files that were not much slower than usual.
+     *  - Multiplicative decrease: it is halved when a file is slower than slow_factor times the fastest of the recent ones (and takes longer than slow_min),
+     *    at most once per limit files, so that one slow round does not halve it several times.
+     * Opens are compared by latency. Reads are compared by seconds per byte, since whole files from KB to hundreds of MB are read:
+     * files smaller than read_min_bytes count as that size, so that the fixed latency of a tiny file does not look slow.
+     * On a busy shared filesystem this backs off instead of piling on more requests, and at quiet times it pushes up to max_limit.
+     * Opens and reads are measured separately, since an open from the page cache is much faster than reading a file.
+     * It is thread-safe: the prefetch threads and the merging thread report to the same controller.
+     */
+    class concurrency {
+        public:
+        enum class op { open, read };
+
+        private:
+        struct Sample {
+            double                                seconds;
+            uintmax_t                             bytes;
+            double                                pace; // What is compared to find slow files: seconds for opens, seconds per byte for reads
+            std::chrono::steady_clock::time_point time; // When it finished
+        };
+        struct Window {
+            std::deque<Sample> samples; // The most recent ones, oldest first
+            [[nodiscard]] double fastest() const; // Lowest pace
+            [[nodiscard]] double percentile(double p) const;
+            [[nodiscard]] double throughput() const; // Bytes per second over the window
+        };
+        static constexpr size_t    window_size    = 256;
+        static constexpr double    slow_factor    = 4.0;
+        static constexpr double    slow_min       = 0.005;           // Seconds. Faster than this is the page cache, whatever the jitter
+        static constexpr uintmax_t read_min_bytes = 1024ul * 1024ul; // Smaller reads are paced as if they were this large
+
+        mutable std::mutex mutex;
+        Window             opens, reads;
+        double             limit;
+        size_t             min_limit;
+        size_t             max_limit;
+        size_t             since_decrease = 0; // Number of reports since the last decrease
+        size_t             num_decrease   = 0;
+
+        public:
+        concurrency(size_t min_limit_, size_t max_limit_);
+        void                      report(op kind, double seconds, uintmax_t bytes); /*!< Call after each open or read of a source file */
+        [[nodiscard]] size_t      get_limit() const;                                /*!< The number of reads that may be in flight now */
+        [[nodiscard]] size_t      get_max_limit() const { return max_limit; }
+        [[nodiscard]] double      percentile(op kind, double p) const; /*!< Latency percentile in seconds, p in [0,1]. Zero without samples */
+        [[nodiscard]] std::string summary() const;                     /*!< The limit and the latency percentiles, for the progress log */
+    };
+}
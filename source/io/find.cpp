@@ -1,17 +1,33 @@
 #include "find.h"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <dirent.h>
+#include <fcntl.h>
+#include <general/iter.h>
+#include <general/pattern.h>
 #include <io/logger.h>
 #include <mpi/mpi-tools.h>
-#include <regex>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <thread>
 #include <tid/tid.h>
+#include <unistd.h>
 namespace tools::io {
     template<bool RECURSIVE>
     std::vector<h5pp::fs::path> find_file(const h5pp::fs::path &base, const std::string &pattern) {
         auto                        t_scope = tid::tic_scope(__FUNCTION__);
         std::vector<h5pp::fs::path> result;
-        std::regex                  reg(pattern);
+        text::pattern               pat(pattern, text::pattern::syntax::regex);
         using dir_iterator = typename std::conditional<RECURSIVE, h5pp::fs::recursive_directory_iterator, h5pp::fs::directory_iterator>::type;
         for(auto &obj : dir_iterator(base))
-            if(h5pp::fs::is_regular_file(obj) and std::regex_match(obj.path().filename().string(), reg)) result.emplace_back(obj);
+            if(h5pp::fs::is_regular_file(obj) and pat.match(obj.path().filename().string())) result.emplace_back(obj);
         return result;
     }
     template std::vector<h5pp::fs::path> find_file<true>(const h5pp::fs::path &base, const std::string &pattern);
@@ -26,11 +42,10 @@ namespace tools::io {
         const bool                  endswith_regex = pattern_wo_subdir.find(regex_suffix, pattern_wo_subdir.size() - regex_suffix.size()) != std::string::npos;
 
         using dir_iterator = typename std::conditional<RECURSIVE, h5pp::fs::recursive_directory_iterator, h5pp::fs::directory_iterator>::type;
-        std::regex reg(pattern_wo_subdir);
-        if(not endswith_regex) reg = std::regex(pattern_wo_subdir + ".*");
+        text::pattern pat(endswith_regex ? pattern_wo_subdir : pattern_wo_subdir + regex_suffix, text::pattern::syntax::regex);
 
         for(const auto &obj : dir_iterator(base)) {
-            auto match = std::regex_match(obj.path().filename().string(), reg);
+            auto match = pat.match(obj.path().filename().string());
             // A valid directory has an output subdirectory
             if(h5pp::fs::is_directory(obj.path()) and match) {
                 if(h5pp::fs::exists(obj.path() / subdir)) result.emplace_back(h5pp::fs::canonical(obj.path() / subdir));
@@ -43,42 +58,261 @@ namespace tools::io {
     template std::vector<h5pp::fs::path> find_dir<true>(const h5pp::fs::path &base, const std::string &pattern, const std::string &subdir);
     template std::vector<h5pp::fs::path> find_dir<false>(const h5pp::fs::path &base, const std::string &pattern, const std::string &subdir);
 
-    std::vector<h5pp::fs::path> find_h5_dirs(const std::vector<h5pp::fs::path> &src_dirs, size_t max_dirs, const std::vector<std::string> & inc,  const std::vector<std::string> & exc) {
+    namespace internal {
+        std::vector<text::pattern> compile_filters(const std::vector<std::string> &keys) {
+            // The keys are globs that may match anywhere in the path, so a plain key matches as a substring, like before
+            std::vector<text::pattern> patterns;
+            patterns.reserve(keys.size());
+            for(const auto &key : keys) patterns.emplace_back(key, text::pattern::syntax::glob);
+            return patterns;
+        }
+
+        bool matches_filters(const std::string &dir, const std::vector<text::pattern> &inc, const std::vector<text::pattern> &exc) {
+            // Check that the keys in inc are present in dir
+            if(not inc.empty()) {
+                bool match = std::any_of(inc.begin(), inc.end(), [&dir](const auto &p) { return p.search(dir); });
+                if(not match) return false;
+            }
+            // Check that the keys in exc are not present in dir
+            if(not exc.empty()) {
+                bool match = std::any_of(exc.begin(), exc.end(), [&dir](const auto &p) { return p.search(dir); });
+                if(match) return false;
+            }
+            return true;
+        }
+
+        /*! \brief Work-stealing queue of directories for the parallel crawler
+         *
+         * Each worker owns a deque: it pushes/pops subdirectories at the back (depth-first, good locality),
+         * and steals from the front of the other deques when its own runs dry. Idle workers sleep until a directory is queued.
+         * The crawl is done when no directory is queued or being scanned.
+         */
+        class crawl_queue {
+            private:
+            struct worker_deque {
+                std::mutex                 mtx;
+                std::deque<h5pp::fs::path> dirs;
+            };
+            std::vector<worker_deque> deques;
+            std::mutex                wait_mtx; // Guards the members below
+            std::condition_variable   wait_cv;
+            size_t                    pending = 0; // Directories queued or being scanned
+            size_t                    pushes  = 0; // Lets an idle worker tell whether a directory was queued since it last looked
+            bool                      stopped = false;
+
+            std::optional<h5pp::fs::path> take(size_t worker) {
+                {
+                    auto                       &own = deques[worker];
+                    std::lock_guard<std::mutex> lock(own.mtx);
+                    if(not own.dirs.empty()) {
+                        auto dir = std::move(own.dirs.back());
+                        own.dirs.pop_back();
+                        return dir;
+                    }
+                }
+                for(size_t i = 1; i < deques.size(); i++) {
+                    auto                       &victim = deques[(worker + i) % deques.size()];
+                    std::lock_guard<std::mutex> lock(victim.mtx);
+                    if(not victim.dirs.empty()) {
+                        auto dir = std::move(victim.dirs.front());
+                        victim.dirs.pop_front();
+                        return dir;
+                    }
+                }
+                return std::nullopt;
+            }
+
+            public:
+            explicit crawl_queue(size_t num_workers) : deques(num_workers) {}
+            void push(size_t worker, h5pp::fs::path dir) {
+                {
+                    std::lock_guard<std::mutex> lock(wait_mtx);
+                    pending++;
+                    pushes++;
+                    std::lock_guard<std::mutex> deque_lock(deques[worker].mtx);
+                    deques[worker].dirs.emplace_back(std::move(dir));
+                }
+                wait_cv.notify_one();
+            }
+            std::optional<h5pp::fs::path> pop(size_t worker) {
+                while(true) {
+                    size_t seen = 0;
+                    {
+                        std::lock_guard<std::mutex> lock(wait_mtx);
+                        if(stopped or pending == 0) return std::nullopt; // Nothing queued and nobody is scanning: we are done
+                        seen = pushes;
+                    }
+                    if(auto dir = take(worker)) return dir;
+                    // Everything queued is taken, but the workers scanning it may queue more
+                    std::unique_lock<std::mutex> lock(wait_mtx);
+                    wait_cv.wait(lock, [&] { return stopped or pending == 0 or pushes != seen; });
+                }
+            }
+            void done() {
+                std::lock_guard<std::mutex> lock(wait_mtx);
+                if(--pending == 0) wait_cv.notify_all();
+            }
+            void stop() {
+                std::lock_guard<std::mutex> lock(wait_mtx);
+                stopped = true;
+                wait_cv.notify_all();
+            }
+        };
+    }
+
+    std::vector<h5pp::fs::path> find_h5_dirs(const std::vector<h5pp::fs::path> &src_dirs, size_t max_dirs, const std::vector<std::string> &inc,
+                                             const std::vector<std::string> &exc, size_t num_threads) {
         auto                        t_scope = tid::tic_scope(__FUNCTION__);
         std::vector<h5pp::fs::path> result;
         if(mpi::world.id == 0) {
-            for(const auto &src_dir : src_dirs) {
-                for(const auto &dir : h5pp::fs::recursive_directory_iterator(src_dir, h5pp::fs::directory_options::follow_directory_symlink)) {
-                    if(dir.is_directory()) {
-                        // Check that the keys in inc are present in dir
-                        if(not inc.empty()){
-                            bool match = std::any_of(inc.begin(), inc.end(),
-                                                     [&dir](const auto& s){ return dir.path().string().find(s) != std::string::npos; });
-                            if(not match) continue;
-                        }
-                        // Check that the keys in exc are not present in dir
-                        if(not exc.empty()){
-                            bool match = std::any_of(exc.begin(), exc.end(),
-                                                     [&dir](const auto& s){ return dir.path().string().find(s) != std::string::npos; });
-                            if(match) continue;
-                        }
+            num_threads = std::max<size_t>(num_threads, 1ul); // The crawl is I/O bound, so we may well use more threads than cores
+            internal::crawl_queue    queue(num_threads);
+            auto                     inc_patterns = internal::compile_filters(inc);
+            auto                     exc_patterns = internal::compile_filters(exc);
+            std::mutex               result_mtx;
+            std::set<h5pp::fs::path> found; // Sorted, and with --maxdirs only the first max_dirs
+            std::atomic<size_t>      crawled = 0;
+            std::exception_ptr       error;
+            for(const auto &[i, src_dir] : iter::enumerate(src_dirs)) queue.push(i % num_threads, src_dir);
+
+            // The result is the first max_dirs directories in sorted order, which is the order of a depth-first crawl with sorted subdirectories.
+            // Once max_dirs are found, a directory that sorts after the last of them cannot contribute, and neither can anything below it.
+            // So the crawl stops early without the result depending on thread timing.
+            auto past_cut = [&](const h5pp::fs::path &dir) {
+                if(max_dirs == 0) return false;
+                std::lock_guard<std::mutex> lock(result_mtx);
+                return found.size() >= max_dirs and *found.rbegin() < dir;
+            };
 
-                        // Check if this directory it has any .h5 files
-                        for(const auto &obj : h5pp::fs::directory_iterator(dir, h5pp::fs::directory_options::follow_directory_symlink)) {
-                            if(obj.is_regular_file() and obj.path().extension() == ".h5") {
-                                result.emplace_back(dir.path());
-                                break;
+            auto crawl = [&](size_t worker) {
+                std::vector<h5pp::fs::path> subdirs;
+                while(auto dir = queue.pop(worker)) {
+                    try {
+                        if(not past_cut(dir.value())) {
+                            // Scan each directory once: queue the subdirectories and check for .h5 files in the same pass
+                            crawled++;
+                            bool has_h5 = false;
+                            subdirs.clear();
+                            for(const auto &obj : h5pp::fs::directory_iterator(dir.value(), h5pp::fs::directory_options::follow_directory_symlink)) {
+                                if(obj.is_directory())
+                                    subdirs.emplace_back(obj.path());
+                                else if(not has_h5 and obj.path().extension() == ".h5" and obj.is_regular_file())
+                                    has_h5 = true;
                             }
+                            // The source roots themselves are not candidates, just like in recursive_directory_iterator
+                            bool is_root = std::find(src_dirs.begin(), src_dirs.end(), dir.value()) != src_dirs.end();
+                            if(has_h5 and not is_root and internal::matches_filters(dir->string(), inc_patterns, exc_patterns)) {
+                                std::lock_guard<std::mutex> lock(result_mtx);
+                                found.emplace(dir.value());
+                                if(max_dirs > 0 and found.size() > max_dirs) found.erase(std::prev(found.end()));
+                            }
+                            // Queued last to first, so that this worker pops them in sorted order
+                            std::sort(subdirs.rbegin(), subdirs.rend());
+                            for(auto &subdir : subdirs)
+                                if(not past_cut(subdir)) queue.push(worker, std::move(subdir));
                         }
-                        if (max_dirs > 0 and result.size() >= max_dirs) break;
+                    } catch(...) {
+                        std::lock_guard<std::mutex> lock(result_mtx);
+                        if(not error) error = std::current_exception();
+                        queue.stop();
                     }
-                    if (max_dirs > 0 and result.size() >= max_dirs) break;
+                    queue.done();
                 }
+            };
+
+            std::vector<std::thread> workers;
+            for(size_t worker = 0; worker < num_threads; worker++) workers.emplace_back(crawl, worker);
+            for(auto &w : workers) w.join();
+            if(error) std::rethrow_exception(error);
+
+            result.assign(found.begin(), found.end());
+            tools::logger::log->info("Crawled {} source directories with {} threads: found {} with .h5 files", crawled.load(), num_threads, result.size());
+        }
+        return result;
+    }
+
+    namespace internal {
+        /*! Converts a timestamp since the unix epoch to the clock used by h5pp::fs::last_write_time.
+         *  The file clock may have a different epoch than the system clock (e.g. libstdc++), but the difference is a whole number of seconds,
+         *  so it can be found exactly by rounding. This way, hashes based on these timestamps match those based on last_write_time.
+         */
+        h5pp::fs::file_time_type to_file_time(long sec, long nsec) {
+            using namespace std::chrono;
+            static const auto epoch_diff  = round<seconds>(h5pp::fs::file_time_type::clock::now().time_since_epoch() - system_clock::now().time_since_epoch());
+            auto              since_epoch = seconds(sec) + nanoseconds(nsec) + epoch_diff;
+            return h5pp::fs::file_time_type(duration_cast<h5pp::fs::file_time_type::duration>(since_epoch));
+        }
+
+        // Stats the entry name relative to the open directory dirfd. Symlinks are followed. Returns nullopt unless it is a regular file.
+        std::optional<FileEntry> stat_at(int dirfd, const char *name, const h5pp::fs::path &path) {
+#if defined(STATX_BASIC_STATS)
+            struct statx stx = {};
+            if(statx(dirfd, name, AT_STATX_SYNC_AS_STAT, STATX_TYPE | STATX_SIZE | STATX_MTIME, &stx) != 0) {
+                tools::logger::log->debug("Could not stat [{}]: {}", path.string(), std::strerror(errno));
+                return std::nullopt;
+            }
+            if(not S_ISREG(stx.stx_mode)) return std::nullopt;
+            return FileEntry{path, stx.stx_size, to_file_time(stx.stx_mtime.tv_sec, stx.stx_mtime.tv_nsec)};
+#else
+            struct stat st = {};
+            if(fstatat(dirfd, name, &st, 0) != 0) {
+                tools::logger::log->debug("Could not stat [{}]: {}", path.string(), std::strerror(errno));
+                return std::nullopt;
             }
-            std::sort(result.begin(),result.end());
+            if(not S_ISREG(st.st_mode)) return std::nullopt;
+            return FileEntry{path, static_cast<uintmax_t>(st.st_size), to_file_time(st.st_mtim.tv_sec, st.st_mtim.tv_nsec)};
+#endif
         }
 
-        mpi::scatter_r(result, 0);
+        // Closes the file descriptor when leaving scope
+        struct fd_guard {
+            int fd = -1;
+            explicit fd_guard(int fd_) : fd(fd_) {}
+            fd_guard(const fd_guard &)            = delete;
+            fd_guard &operator=(const fd_guard &) = delete;
+            ~fd_guard() {
+                if(fd >= 0) close(fd);
+            }
+        };
+    }
+
+    std::optional<FileEntry> stat_file(const h5pp::fs::path &path) { return internal::stat_at(AT_FDCWD, path.c_str(), path); }
+
+    /*! \brief Lists the regular .h5 files in dir, sorted by name, with their size and modification time.
+     *
+     * The entries are read in bulk with getdents64, and filtered on name and d_type without touching any inode.
+     * Only the surviving candidates are then stat'ed, in a single pass relative to the open directory.
+     * On parallel filesystems every metadata call is a round trip, so callers should reuse the cached
+     * size and mtime instead of asking the filesystem again.
+     */
+    std::vector<FileEntry> list_h5_files(const h5pp::fs::path &dir) {
+        auto t_scope = tid::tic_scope(__FUNCTION__);
+        auto dirfd   = internal::fd_guard(open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+        if(dirfd.fd < 0) throw std::runtime_error(h5pp::format("Could not open directory [{}]: {}", dir.string(), std::strerror(errno)));
+
+        std::vector<std::string> names;
+        std::vector<char>        buffer(64 * 1024);
+        while(true) {
+            auto nread = syscall(SYS_getdents64, dirfd.fd, buffer.data(), buffer.size());
+            if(nread < 0) throw std::runtime_error(h5pp::format("Could not read directory [{}]: {}", dir.string(), std::strerror(errno)));
+            if(nread == 0) break;
+            for(long pos = 0; pos < nread;) {
+                auto *entry = reinterpret_cast<struct dirent64 *>(buffer.data() + pos);
+                pos += entry->d_reclen;
+                // Symlinks are resolved by stat later. Some filesystems do not fill d_type, in which case it is DT_UNKNOWN.
+                if(entry->d_type != DT_REG and entry->d_type != DT_LNK and entry->d_type != DT_UNKNOWN) continue;
+                std::string_view name(entry->d_name);
+                if(name.size() <= 3 or name.substr(name.size() - 3) != ".h5") continue;
+                names.emplace_back(name);
+            }
+        }
+        std::sort(names.begin(), names.end());
+
+        std::vector<FileEntry> result;
+        result.reserve(names.size());
+        for(const auto &name : names) {
+            if(auto entry = internal::stat_at(dirfd.fd, name.c_str(), dir / name)) result.emplace_back(std::move(entry.value()));
+        }
         return result;
     }
 
@@ -2,17 +2,28 @@
 
 #include <h5pp/details/h5ppFilesystem.h>
 #include <h5pp/details/h5ppFormat.h>
+#include <optional>
 #include <vector>
 
 namespace tools::io {
+    /*! \brief A regular file found in a directory, with the metadata we need from it cached */
+    struct FileEntry {
+        h5pp::fs::path           path;
+        uintmax_t                size = 0;
+        h5pp::fs::file_time_type mtime;
+    };
     template<bool RECURSIVE>
     std::vector<h5pp::fs::path> find_file(const h5pp::fs::path &base, const std::string &pattern);
 
     template<bool RECURSIVE>
     std::vector<h5pp::fs::path> find_dir(const h5pp::fs::path &base, const std::string &pattern, const std::string &subdir = "/output");
 
-    std::vector<h5pp::fs::path> find_h5_dirs(const std::vector<h5pp::fs::path> &src_dirs, size_t max_dirs,
-                                             const std::vector<std::string> & inc, const std::vector<std::string> & exc);
+    // Only id 0 crawls: the other ids get an empty result, and the directories are distributed afterwards
+    std::vector<h5pp::fs::path> find_h5_dirs(const std::vector<h5pp::fs::path> &src_dirs, size_t max_dirs, const std::vector<std::string> &inc,
+                                             const std::vector<std::string> &exc, size_t num_threads = 1);
+
+    std::optional<FileEntry> stat_file(const h5pp::fs::path &path);
+    std::vector<FileEntry>   list_h5_files(const h5pp::fs::path &dir);
 
 }
 
@@ -6,6 +6,7 @@
 #include <io/id.h>
 #include <io/logger.h>
 #include <io/meta.h>
+#include <io/parse.h>
 #include <string>
 #include <tid/tid.h>
 #include <unordered_map>
@@ -32,6 +33,7 @@ namespace tools::h5db {
         auto keyword = [&keys](){
             if(keys.empty()) return std::string{};
             if constexpr(std::is_same_v<KeyType, ModelKey>) return keys.front().model;
+            else if constexpr(std::is_same_v<KeyType, CronoKey> and std::is_same_v<InfoType, h5pp::DsetInfo>) return std::string("crono2d");
             else if constexpr(std::is_same_v<KeyType, CronoKey>) return std::string("cronos");
             else if constexpr(std::is_same_v<KeyType, ScaleKey>) return std::string("scales"); // Or fes?
             else return keys.front().point;
@@ -85,6 +87,7 @@ namespace tools::h5db {
     template std::unordered_map<std::string, InfoId<h5pp::DsetInfo>>    loadDatabase(const h5pp::File &h5_tgt, const std::vector<DsetKey> &keys);
     template std::unordered_map<std::string, InfoId<h5pp::TableInfo>>   loadDatabase(const h5pp::File &h5_tgt, const std::vector<TableKey> &keys);
     template std::unordered_map<std::string, InfoId<BufferedTableInfo>> loadDatabase(const h5pp::File &h5_tgt, const std::vector<CronoKey> &keys);
+    template std::unordered_map<std::string, InfoId<h5pp::DsetInfo>>    loadDatabase(const h5pp::File &h5_tgt, const std::vector<CronoKey> &keys);
     template std::unordered_map<std::string, InfoId<BufferedTableInfo>> loadDatabase(const h5pp::File &h5_tgt, const std::vector<ScaleKey> &keys);
     template std::unordered_map<std::string, InfoId<h5pp::TableInfo>>   loadDatabase(const h5pp::File &h5_tgt, const std::vector<ModelKey> &keys);
 
@@ -230,4 +233,105 @@ namespace tools::h5db {
             throw std::runtime_error(
                 h5pp::format("Hashes and seeds do not match. Something is wrong! \n Old entry {}\n New entry {}", oldFileId.string(), newFileId.string()));
     }
+
+    ManifestId getManifestId(const h5pp::fs::path &h5dir, const std::vector<tools::io::FileEntry> &h5files) {
+        auto t_scope = tid::tic_scope(__FUNCTION__);
+        // The directory mtime changes whenever a file is added, removed or renamed in it.
+        // Together with the number of files and the highest seed, this tells us if the directory has changed
+        // since the last merge. Writing to an existing file does not change the directory, so the newest file mtime
+        // is included too: it is in the listing already, so no file has to be stat'ed again.
+        auto   mtime  = h5pp::fs::last_write_time(h5dir).time_since_epoch().count();
+        size_t count  = 0;
+        long   seed   = -1;
+        long   newest = 0;
+        for(const auto &h5file : h5files) {
+            if(h5file.path.extension() != ".h5") continue;
+            count++;
+            seed   = std::max(seed, tools::parse::extract_digits_from_h5_filename<long>(h5file.path.filename()));
+            newest = std::max(newest, static_cast<long>(h5file.mtime.time_since_epoch().count()));
+        }
+        return ManifestId(h5dir.string(), static_cast<long>(mtime), count, seed, newest);
+    }
+
+    std::unordered_map<std::string, QuarantineId> loadQuarantine(const h5pp::File &h5_tgt) {
+        auto                                          t_scope = tid::tic_scope(__FUNCTION__);
+        std::unordered_map<std::string, QuarantineId> quarantineDb;
+        if(h5_tgt.linkExists(".db/quarantine")) {
+            auto database = h5_tgt.readTableRecords<std::vector<QuarantineId>>(".db/quarantine");
+            for(auto &item : database) quarantineDb[item.path] = item;
+            tools::logger::log->info("Loaded {} quarantined files", quarantineDb.size());
+        }
+        return quarantineDb;
+    }
+
+    void saveQuarantine(h5pp::File &h5_tgt, const std::unordered_map<std::string, QuarantineId> &quarantineDb) {
+        auto t_scope = tid::tic_scope(__FUNCTION__);
+        std::vector<QuarantineId> quarantineVec;
+        for(const auto &[path, quarantineId] : quarantineDb) quarantineVec.emplace_back(quarantineId);
+        std::sort(quarantineVec.begin(), quarantineVec.end(), [](auto &lhs, auto &rhs) { return lhs.seed < rhs.seed; });
+        if(h5_tgt.linkExists(".db/quarantine") and h5_tgt.getTableInfo(".db/quarantine").numRecords.value() > quarantineVec.size()) {
+            // Files have left the quarantine. Tables do not shrink, so start over
+            H5Ldelete(h5_tgt.openFileHandle(), ".db/quarantine", H5P_DEFAULT);
+        }
+        if(quarantineVec.empty()) return;
+        tools::logger::log->debug("Writing database: .db/quarantine");
+        if(not h5_tgt.linkExists(".db/quarantine")) {
+            H5T_QuarantineId::register_table_type();
+            h5_tgt.createTable(H5T_QuarantineId::h5_type, ".db/quarantine", "Quarantined source files", {100}, 3);
+        }
+        h5_tgt.writeTableRecords(quarantineVec, ".db/quarantine", 0);
+    }
+
+    bool isQuarantined(const std::unordered_map<std::string, QuarantineId> &quarantineDb, const FileId &fileId) {
+        // The file stays in quarantine until its hash, and thereby its mtime, changes
+        auto res = quarantineDb.find(fileId.path);
+        if(res == quarantineDb.end()) return false;
+        return res->second.seed == fileId.seed and std::string_view(res->second.hash) == std::string_view(fileId.hash);
+    }
+
+    ProgressId &getProgress(const h5pp::File &h5_tgt, std::unordered_map<std::string, ProgressId> &progressDb, const std::string &path) {
+        // The progress databases are only read for the crono tables that are merged into, so there is no need to search for them all
+        auto res = progressDb.find(path);
+        if(res != progressDb.end()) return res->second;
+        if(not h5_tgt.linkExists(path)) return progressDb[path];
+        auto t_scope = tid::tic_scope("loadProgress");
+        tools::logger::log->debug("Loading database {}", path);
+        return progressDb[path] = ProgressId(h5_tgt.readTableRecords<std::vector<SeedId>>(path));
+    }
+
+    void saveProgress(h5pp::File &h5_tgt, const std::unordered_map<std::string, ProgressId> &progressDb) {
+        auto t_scope = tid::tic_scope(__FUNCTION__);
+        for(const auto &[path, progressId] : progressDb) {
+            if(not progressId.db_modified()) continue;
+            std::vector<SeedId> seedIdVec;
+            for(const auto &[seed, count] : progressId.get_db()) seedIdVec.emplace_back(SeedId{seed, count});
+            std::sort(seedIdVec.begin(), seedIdVec.end(), [](auto &lhs, auto &rhs) { return lhs.seed < rhs.seed; });
+            tools::logger::log->debug("Saving database: {}", path);
+            if(not h5_tgt.linkExists(path)) {
+                H5T_SeedId::register_table_type();
+                h5_tgt.createTable(H5T_SeedId::h5_type, path, "Crono records merged per seed", {1000}, 4);
+            }
+            h5_tgt.writeTableRecords(seedIdVec, path, 0);
+        }
+    }
+
+    std::optional<ManifestId> loadManifest(const h5pp::File &h5_tgt) {
+        auto t_scope = tid::tic_scope(__FUNCTION__);
+        if(not h5_tgt.linkExists(".db/manifest")) return std::nullopt;
+        return h5_tgt.readTableRecords<ManifestId>(".db/manifest", h5pp::TableSelection::LAST);
+    }
+
+    void saveManifest(h5pp::File &h5_tgt, const ManifestId &manifestId) {
+        auto t_scope = tid::tic_scope(__FUNCTION__);
+        tools::logger::log->debug("Writing manifest: {}", manifestId.string());
+        if(h5_tgt.linkExists(".db/manifest") and H5Tget_member_index(h5_tgt.getTableInfo(".db/manifest").h5Type.value(), "newest") < 0) {
+            // Written before the newest file mtime was part of the manifest. Writing to it would drop that field, so start over
+            H5Ldelete(h5_tgt.openFileHandle(), ".db/manifest", H5P_DEFAULT);
+        }
+        if(not h5_tgt.linkExists(".db/manifest")) {
+            H5T_ManifestId::register_table_type();
+            h5_tgt.createTable(H5T_ManifestId::h5_type, ".db/manifest", "Manifest of the source directory", {10});
+        }
+        h5_tgt.writeTableRecords(manifestId, ".db/manifest", 0);
+    }
 }
@@ -2,8 +2,10 @@
 #include <general/enums.h>
 #include <h5pp/details/h5ppFilesystem.h>
 #include <h5pp/details/h5ppInfo.h>
+#include <io/find.h>
 #include <io/id.h>
 #include <io/meta.h>
+#include <optional>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -53,6 +55,24 @@ namespace tools::h5db {
         }
     };
 
+    /*! \brief The objects to merge from a source file, as found by the key discovery in merge
+     *
+     * Source files with the same layout have the same plan, so it is made once and reused for the others:
+     * these only have their objects reopened, without searching for groups or checking that links exist.
+     */
+    struct MergePlan {
+        struct Point {
+            PathId                pathid;
+            std::vector<DsetKey>  dsets;
+            std::vector<TableKey> tables;
+            std::vector<CronoKey> cronos;
+            std::vector<ScaleKey> scales;
+        };
+        std::string             modelKey; // Key of the model in SrcDb::model
+        std::vector<Point>      points;
+        static constexpr size_t max_cached = 16; // Plans kept per source directory
+    };
+
     template<typename ModelType>
     struct SrcDb {
         h5pp::fs::path                                   parent_path;
@@ -61,12 +81,29 @@ namespace tools::h5db {
         std::unordered_map<std::string, h5pp::TableInfo> crono;
         std::unordered_map<std::string, h5pp::TableInfo> scale;
         std::unordered_map<std::string, ModelType>       model;
+        std::unordered_map<uint64_t, MergePlan>          plan; // Keyed by the layout signature of the source file
         void                                             clear() {
             dset.clear();
             table.clear();
             crono.clear();
             scale.clear();
             model.clear();
+            plan.clear();
+        }
+        void release() {
+            // Drop the handles into the last source file, so that it is not kept open (and locked) after merging it.
+            // They are renewed in gather*Keys for the next source file.
+            for(auto &[key, info] : dset) {
+                info.h5File  = std::nullopt;
+                info.h5Dset  = std::nullopt;
+                info.h5Space = std::nullopt;
+            }
+            for(auto *db : {&table, &crono, &scale}) {
+                for(auto &[key, info] : *db) {
+                    info.h5File = std::nullopt;
+                    info.h5Dset = std::nullopt;
+                }
+            }
         }
     };
 
@@ -75,15 +112,21 @@ namespace tools::h5db {
         std::unordered_map<std::string, InfoId<h5pp::DsetInfo>>    dset;
         std::unordered_map<std::string, InfoId<h5pp::TableInfo>>   table;
         std::unordered_map<std::string, InfoId<BufferedTableInfo>> crono;
+        std::unordered_map<std::string, InfoId<h5pp::DsetInfo>>    crono2d; // The [iteration x seed] datasets made instead of crono with --crono2d
         std::unordered_map<std::string, InfoId<BufferedTableInfo>> scale;
         std::unordered_map<std::string, InfoId<h5pp::TableInfo>>   model;
+        std::unordered_map<std::string, QuarantineId>              quarantine; // Source files that failed, keyed by path
+        std::unordered_map<std::string, ProgressId>                progress;   // Crono records merged per seed, keyed by PathId::progress_path
         void                                                       clear() {
             file.clear();
+            quarantine.clear();
             dset.clear();
             table.clear();
             crono.clear();
+            crono2d.clear();
             scale.clear();
             model.clear();
+            progress.clear();
         }
     };
 
@@ -99,4 +142,16 @@ namespace tools::h5db {
 
     FileIdStatus getFileIdStatus(const std::unordered_map<std::string, FileId> &fileIdDb, const FileId &newFileId);
 
+    std::unordered_map<std::string, QuarantineId> loadQuarantine(const h5pp::File &h5_tgt);
+    void                                          saveQuarantine(h5pp::File &h5_tgt, const std::unordered_map<std::string, QuarantineId> &quarantineDb);
+    [[nodiscard]] bool isQuarantined(const std::unordered_map<std::string, QuarantineId> &quarantineDb, const FileId &fileId);
+
+    /*! \brief The progress database at path, loaded from h5_tgt into progressDb on first use */
+    ProgressId &getProgress(const h5pp::File &h5_tgt, std::unordered_map<std::string, ProgressId> &progressDb, const std::string &path);
+    void        saveProgress(h5pp::File &h5_tgt, const std::unordered_map<std::string, ProgressId> &progressDb);
+
+    ManifestId                getManifestId(const h5pp::fs::path &h5dir, const std::vector<tools::io::FileEntry> &h5files);
+    std::optional<ManifestId> loadManifest(const h5pp::File &h5_tgt);
+    void                      saveManifest(h5pp::File &h5_tgt, const ManifestId &manifestId);
+
 }
@@ -1,10 +1,12 @@
 #include "h5io.h"
+#include <array>
 #include <cstdlib>
 #include <functional>
 #include <general/prof.h>
 #include <general/text.h>
 #include <h5pp/h5pp.h>
 #include <io/h5dbg.h>
+#include <io/h5raw.h>
 #include <io/id.h>
 #include <io/logger.h>
 #include <io/meta.h>
@@ -23,10 +25,86 @@
 namespace tools::h5io {
     std::string get_tmp_dirname(std::string_view exename) { return fmt::format("{}.{}", h5pp::fs::path(exename).filename().string(), getenv("USER")); }
 
+    void setSourceProfile(hid_t fapl) {
+        static const H5AC_cache_config_t mdc_config = []() {
+            H5AC_cache_config_t config;
+            config.version = H5AC__CURR_CACHE_CONFIG_VERSION;
+            hid_t plist    = H5Pcreate(H5P_FILE_ACCESS);
+            H5Pget_mdc_config(plist, &config);
+            H5Pclose(plist);
+            // The metadata of a source file takes a few kB: the default cache of 2 MB (at least 1 MB) is set up and torn down for nothing
+            config.set_initial_size = true;
+            config.initial_size     = 128 * 1024;
+            config.min_size         = 64 * 1024;
+            config.max_size         = 4 * 1024 * 1024;
+            return config;
+        }();
+        // The settings only make opening cheaper, so the file is opened without the ones that fail.
+        // Their errors are cleared, or merge would find them on the HDF5 error stack and reject the file.
+        static bool warned = false; // Every source file comes through here: warn only once
+        auto        check  = [](herr_t err, std::string_view setting) {
+            if(err >= 0) return;
+            H5Eclear(H5E_DEFAULT);
+            if(warned)
+                tools::logger::log->debug("Could not set {} for a source file", setting);
+            else
+                tools::logger::log->warn("Could not set {} for source files: opening them without it", setting);
+            warned = true;
+        };
+        auto cfg = mdc_config; // H5Pset_mdc_config takes a non-const pointer
+        check(H5Pset_mdc_config(fapl, &cfg), "the metadata cache size");
+        check(H5Pset_evict_on_close(fapl, true), "evict on close");
+#if H5_VERSION_GE(1, 12, 1) or (H5_VERS_MAJOR == 1 and H5_VERS_MINOR == 10 and H5_VERS_RELEASE >= 7)
+        // Locking is off because it is slow on NFS and Lustre. A file that is read mid-write ends up quarantined or skipped until it changes
+        check(H5Pset_file_locking(fapl, false, true), "file locking");
+#endif
+        // Only affects new objects: older files are still read
+        check(H5Pset_libver_bounds(fapl, H5F_LIBVER_LATEST, H5F_LIBVER_LATEST), "the library version bounds");
+    }
+
     namespace internal {
-        void copy_dset(h5pp::File &h5_tgt, const h5pp::File &h5_src, h5pp::DsetInfo &tgtInfo, h5pp::DsetInfo &srcInfo, hsize_t index, size_t axis) {
+        void renewDsetInfo(const h5pp::File &h5_src, h5pp::DsetInfo &srcInfo) {
+            // Like in gatherDsetKeys, but the dataset is known to exist: only reopen it and renew its size
+            h5pp::Options options;
+            srcInfo.h5File     = h5_src.openFileHandle();
+            srcInfo.h5Dset     = std::nullopt;
+            srcInfo.h5Space    = std::nullopt;
+            srcInfo.dsetExists = true;
+            srcInfo.dsetSize   = std::nullopt;
+            srcInfo.dsetDims   = std::nullopt;
+            srcInfo.dsetByte   = std::nullopt;
+            h5pp::scan::readDsetInfo(srcInfo, srcInfo.h5File.value(), options, h5_src.plists);
+        }
+        void renewTableInfo(const h5pp::File &h5_src, h5pp::TableInfo &srcInfo) {
+            // Like in gatherTableKeys, but the table is known to exist: only reopen it and renew its number of records
+            h5pp::Options options;
+            srcInfo.h5File      = h5_src.openFileHandle();
+            srcInfo.h5Dset      = std::nullopt;
+            srcInfo.numRecords  = std::nullopt;
+            srcInfo.tableExists = true;
+            h5pp::scan::readTableInfo(srcInfo, srcInfo.h5File.value(), options, h5_src.plists);
+        }
+
+        h5pp::DsetInfo missingDsetInfo(const std::string &path) {
+            // What getDatasetInfo gives for a missing dataset, without asking HDF5 again
+            h5pp::DsetInfo info;
+            info.dsetPath   = path;
+            info.dsetExists = false;
+            return info;
+        }
+
+        h5pp::TableInfo missingTableInfo(const std::string &path) {
+            h5pp::TableInfo info;
+            info.tablePath   = path;
+            info.tableExists = false;
+            return info;
+        }
+
+        void copy_dset(h5pp::File &h5_tgt, const h5pp::File &h5_src, h5pp::DsetInfo &tgtInfo, h5pp::DsetInfo &srcInfo, hsize_t index, size_t axis,
+                       std::vector<std::byte> *raw = nullptr) {
+            // raw, if given, holds the source data read already by tools::h5raw
             auto t_scope = tid::tic_scope(__FUNCTION__);
-            auto data = h5_src.readDataset<std::vector<std::byte>>(srcInfo); // Read the data into a generic buffer.
+            auto data = raw != nullptr ? std::move(*raw) : h5_src.readDataset<std::vector<std::byte>>(srcInfo); // Read the data into a generic buffer.
             h5pp::DataInfo dataInfo;
 
             // The axis parameter must be  < srcInfo.rank+1
@@ -55,20 +133,169 @@ namespace tools::h5io {
             tgtInfo.dsetSlab     = std::nullopt;
         }
 
-        struct SearchResult {
-            std::string                      root;
-            std::string                      key;
-            long                             hits;
-            long                             depth;
-            mutable std::vector<std::string> result;
-            bool                             operator==(const SearchResult &rhs) const {
-                return this->root == rhs.root and this->key == rhs.key and this->hits == rhs.hits and this->depth == rhs.depth;
+        constexpr hsize_t crono2d_chunk_seeds = 16;              // Seeds per chunk of a crono2d dataset: few, so that a chunk is soon full
+        constexpr size_t  crono2d_chunk_bytes = 1024 * 1024;     // The iterations per chunk are capped to keep chunks about this size
+        constexpr size_t  crono2d_cache_bytes = 32 * 1024 * 1024; // Chunk cache of each crono2d dataset
+
+        void cache_crono2d(const h5pp::File &h5_tgt, h5pp::DsetInfo &info) {
+            // With the default chunk cache of 1 MB, the chunks that the current seeds write into would be evicted before they are full.
+            // Each would then be read, decompressed and compressed again for every seed. Reopen the dataset with a larger cache, once.
+            h5pp::hid::h5p dapl   = H5Dget_access_plist(info.h5Dset.value());
+            size_t         nslots = 0;
+            size_t         nbytes = 0;
+            double         w0     = 0;
+            if(H5Pget_chunk_cache(dapl, &nslots, &nbytes, &w0) < 0) throw std::runtime_error("H5Pget_chunk_cache failed");
+            if(nbytes == crono2d_cache_bytes) return;
+            H5Pset_chunk_cache(dapl, 12421, crono2d_cache_bytes, 1.0); // w0 = 1: chunks that were written in full are evicted first
+            // The cache belongs to the open dataset, shared by all its ids, so the old id must be closed first
+            info.h5Dset = std::nullopt;
+            hid_t dset  = H5Dopen2(h5_tgt.openFileHandle(), info.dsetPath.value().c_str(), dapl);
+            if(dset < 0) throw std::runtime_error(h5pp::format("Failed to reopen [{}]", info.dsetPath.value()));
+            info.h5Dset = dset;
+        }
+
+        void write_crono2d(h5pp::DsetInfo &info, const std::byte *data, hsize_t row, hsize_t rows, hsize_t col, hsize_t cols) {
+            // Writes [rows x cols] records, row-major in data, at [row, col] in the [iteration x seed] dataset info, which grows to fit them
+            auto dims    = info.dsetDims.value();
+            auto newDims = std::vector<hsize_t>{std::max(dims.at(0), row + rows), std::max(dims.at(1), col + cols)};
+            if(newDims != dims) {
+                if(H5Dset_extent(info.h5Dset.value(), newDims.data()) < 0)
+                    throw std::runtime_error(h5pp::format("Failed to extend [{}] to {}", info.dsetPath.value(), newDims));
+                info.dsetDims = newDims;
+                info.dsetSize = newDims[0] * newDims[1];
+                info.h5Space  = H5Dget_space(info.h5Dset.value());
             }
-        };
+            std::array<hsize_t, 2> offset = {row, col};
+            std::array<hsize_t, 2> count  = {rows, cols};
+            h5pp::hid::h5s         dspace = H5Dget_space(info.h5Dset.value());
+            h5pp::hid::h5s         mspace = H5Screate_simple(2, count.data(), nullptr);
+            H5Sselect_hyperslab(dspace, H5S_SELECT_SET, offset.data(), nullptr, count.data(), nullptr);
+            if(H5Dwrite(info.h5Dset.value(), info.h5Type.value(), mspace, dspace, H5P_DEFAULT, data) < 0)
+                throw std::runtime_error(h5pp::format("Failed to write [{} x {}] records at [{}, {}] in [{}]", rows, cols, row, col, info.dsetPath.value()));
+        }
 
-        struct SearchHasher {
-            auto operator()(const SearchResult &r) const { return std::hash<std::string>{}(fmt::format("{}|{}|{}|{}", r.root, r.key, r.hits, r.depth)); }
+        void read_crono2d(const h5pp::DsetInfo &info, std::vector<std::byte> &buffer, hsize_t row, hsize_t rows, hsize_t col, hsize_t cols) {
+            // Reads [rows x cols] records at [row, col] into buffer, row-major
+            std::array<hsize_t, 2> offset = {row, col};
+            std::array<hsize_t, 2> count  = {rows, cols};
+            h5pp::hid::h5s         dspace = H5Dget_space(info.h5Dset.value());
+            h5pp::hid::h5s         mspace = H5Screate_simple(2, count.data(), nullptr);
+            H5Sselect_hyperslab(dspace, H5S_SELECT_SET, offset.data(), nullptr, count.data(), nullptr);
+            buffer.resize(rows * cols * H5Tget_size(info.h5Type.value()));
+            if(H5Dread(info.h5Dset.value(), info.h5Type.value(), mspace, dspace, H5P_DEFAULT, buffer.data()) < 0)
+                throw std::runtime_error(h5pp::format("Failed to read [{} x {}] records at [{}, {}] in [{}]", rows, cols, row, col, info.dsetPath.value()));
+        }
+
+        void copy_link(h5pp::File &h5_tgt, const h5pp::File &h5_src, const std::string &linkPath) {
+            // Copies the object at linkPath, with everything below it, into the same path in h5_tgt. Missing parent groups are created.
+            auto t_scope = tid::tic_scope(__FUNCTION__);
+            tools::logger::log->debug("Copying {} -> {}", linkPath, h5_tgt.getFilePath());
+            herr_t err = H5Ocopy(h5_src.openFileHandle(), linkPath.c_str(), h5_tgt.openFileHandle(), linkPath.c_str(), H5P_DEFAULT, h5_tgt.plists.linkCreate);
+            if(err < 0) {
+                H5Eprint(H5E_DEFAULT, stderr);
+                throw std::runtime_error(h5pp::format("Failed to copy [{}] from [{}] to [{}]", linkPath, h5_src.getFilePath(), h5_tgt.getFilePath()));
+            }
+        }
+
+    }
+
+    LinkIndex::LinkIndex(const h5pp::File &h5_src) {
+        auto t_scope  = tid::tic_scope("index");
+        auto keepOpen = h5_src.getFileHandleToken();
+        // The objects are visited in name order, which does not depend on the order they were created in
+#if H5_VERSION_GE(1, 12, 0)
+        herr_t err = H5Ovisit3(h5_src.openFileHandle(), H5_INDEX_NAME, H5_ITER_INC, visit, this, H5O_INFO_BASIC);
+#else
+        herr_t err = H5Ovisit2(h5_src.openFileHandle(), H5_INDEX_NAME, H5_ITER_INC, visit, this, H5O_INFO_BASIC);
+#endif
+        if(err < 0) throw std::runtime_error(h5pp::format("Failed to visit the objects in [{}]", h5_src.getFilePath()));
+    }
+
+    herr_t LinkIndex::visit(hid_t /* obj */, const char *name, const object_info_t *info, void *data) {
+        auto &self = *static_cast<LinkIndex *>(data);
+        if(std::string_view(name) == ".") return 0; // The root group
+#if H5_VERSION_GE(1, 12, 0)
+        self.objects.emplace(name, Object{info->type, info->token});
+#else
+        self.objects.emplace(name, Object{info->type, info->addr});
+#endif
+        return 0;
+    }
+
+    const LinkIndex::Object *LinkIndex::find(std::string_view path) const {
+        while(not path.empty() and path.front() == '/') path.remove_prefix(1);
+        while(not path.empty() and path.back() == '/') path.remove_suffix(1);
+        auto it = objects.find(path);
+        return it == objects.end() ? nullptr : &it->second;
+    }
+    bool LinkIndex::exists(std::string_view path) const { return find(path) != nullptr; }
+    bool LinkIndex::is_group(std::string_view path) const {
+        auto obj = find(path);
+        return obj != nullptr and obj->type == H5O_TYPE_GROUP;
+    }
+    bool LinkIndex::is_dataset(std::string_view path) const {
+        auto obj = find(path);
+        return obj != nullptr and obj->type == H5O_TYPE_DATASET;
+    }
+
+    uint64_t LinkIndex::get_signature(const tools::h5db::Keys &keys) const {
+        auto     t_scope = tid::tic_scope("signature");
+        uint64_t hash    = 14695981039346656037ull;
+        auto     add     = [&hash](std::string_view path, bool found) {
+            // The path, then a separator that also says whether it was found, so that "ab" + "c" differs from "a" + "bc"
+            for(auto c : path) hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+            hash = (hash ^ (found ? 0xfeu : 0xffu)) * 1099511628211ull;
         };
+        // The same lookups as in merge, gatherDsetKeys, gatherTableKeys, gatherCronoKeys and gatherScaleKeys, but without HDF5
+        for(const auto &srcKey : keys.models) {
+            auto path = fmt::format("{}/{}/{}", srcKey.algo, srcKey.model, srcKey.name);
+            add(path, exists(path));
+        }
+        for(const auto &algo : findKeys(*this, "/", keys.get_algos(), -1, 0)) {
+            add(algo, true);
+            for(const auto &state : findKeys(*this, algo, keys.get_states(), -1, 0)) {
+                auto algo_state = fmt::format("{}/{}", algo, state);
+                add(algo_state, true);
+                for(const auto &point : findKeys(*this, algo_state, keys.get_points(), -1, 1)) {
+                    PathId pathid("", algo, state, point);
+                    add(pathid.src_path, true);
+                    auto add_keys = [&](const auto &srcKeys) {
+                        for(const auto &srcKey : srcKeys) {
+                            if(not pathid.match(srcKey.algo, srcKey.state, srcKey.point)) continue;
+                            auto path = fmt::format("{}/{}", pathid.src_path, srcKey.name);
+                            add(path, is_dataset(path));
+                        }
+                    };
+                    add_keys(keys.dsets);
+                    add_keys(keys.tables);
+                    add_keys(keys.cronos);
+                    for(const auto &srcKey : keys.scales) {
+                        if(not pathid.match(srcKey.algo, srcKey.state, srcKey.point)) continue;
+                        for(const auto &scaleKey : findKeys(*this, pathid.src_path, {srcKey.scale}, -1, 1)) {
+                            auto path = fmt::format("{}/{}/{}", pathid.src_path, scaleKey, srcKey.name);
+                            add(path, is_dataset(path));
+                        }
+                    }
+                }
+            }
+        }
+        return hash;
+    }
+
+    std::vector<std::string> LinkIndex::find_groups(std::string_view key, std::string_view root, long hits, long depth) const {
+        while(not root.empty() and root.front() == '/') root.remove_prefix(1);
+        while(not root.empty() and root.back() == '/') root.remove_suffix(1);
+        std::string prefix = root.empty() ? std::string() : fmt::format("{}/", root);
+        // The paths below root are adjacent in the map, starting from the first one not less than the prefix
+        std::vector<std::string> result;
+        for(auto it = objects.lower_bound(prefix); it != objects.end() and text::startsWith(it->first, prefix); it++) {
+            auto relPath = std::string_view(it->first).substr(prefix.size());
+            if(it->second.type != H5O_TYPE_GROUP or relPath.find(key) == std::string_view::npos) continue;
+            if(depth >= 0 and std::count(relPath.begin(), relPath.end(), '/') > depth) continue;
+            result.emplace_back(relPath);
+            if(hits > 0 and static_cast<long>(result.size()) >= hits) break;
+        }
+        return result;
     }
 
     template<typename T>
@@ -95,62 +322,46 @@ namespace tools::h5io {
     template std::string get_standardized_base(const ModelId<sdual> &H, int decimals);
     template std::string get_standardized_base(const ModelId<lbit> &H, int decimals);
 
-    std::vector<std::string> findKeys(const h5pp::File &h5_src, const std::string &root, const std::vector<std::string> &expectedKeys, long hits, long depth) {
-        auto                                                                      t_scope = tid::tic_scope(__FUNCTION__);
-        static std::unordered_set<internal::SearchResult, internal::SearchHasher> cache;
-        std::vector<std::string>                                                  result;
+    std::vector<std::string> findKeys(const LinkIndex &srcIndex, const std::string &root, const std::vector<std::string> &expectedKeys, long hits,
+                                      long depth) {
+        auto                     t_scope = tid::tic_scope(__FUNCTION__);
+        std::vector<std::string> result;
         for(const auto &key : expectedKeys) {
-            internal::SearchResult searchQuery = {root, key, hits, depth, {}};
-            std::string            cacheMsg;
-            auto                   cachedIt = cache.find(searchQuery);
-            bool                   cacheHit = cachedIt != cache.end() and                         // The search query has been processed earlier
-                            ((hits > 0 and static_cast<long>(cachedIt->result.size()) >= hits) or // Asked for a up to "hits" reslts
-                             (hits <= 0 and static_cast<long>(cachedIt->result.size()) >= 1)      // Asked for any number of results
-                            );
-            if(cacheHit) {
-                for(auto &item : cachedIt->result) {
-                    if(result.size() > 1 and std::find(result.begin(), result.end(), item) != result.end()) continue;
-                    result.emplace_back(item);
+            std::vector<std::string> found;
+            if(key.empty())
+                found.emplace_back(key);
+            else if(key.back() == '*') {
+                std::string_view key_match = std::string_view(key).substr(0, key.size() - 2); // .substr(0,key.size()-2);
+                for(auto &item : srcIndex.find_groups(key_match, root, hits, depth)) {
+                    if(not text::startsWith(item, key_match)) continue;
+                    if(found.size() > 1 and std::find(found.begin(), found.end(), item) != found.end()) continue;
+                    found.emplace_back(item);
                 }
-                cacheMsg = " | cache hit";
             } else {
-                std::vector<std::string> found;
-                if(key.empty())
-                    found.emplace_back(key);
-                else if(key.back() == '*') {
-                    std::string_view key_match = std::string_view(key).substr(0, key.size() - 2); // .substr(0,key.size()-2);
-                    for(auto &item : h5_src.findGroups(key_match, root, hits, depth)) {
-                        if(not text::startsWith(item, key_match)) continue;
-                        if(found.size() > 1 and std::find(found.begin(), found.end(), item) != found.end()) continue;
-                        found.emplace_back(item);
-                    }
-                } else {
-                    for(auto &item : h5_src.findGroups(key, root, hits, depth)) {
-                        if(not text::endsWith(item, key)) continue;
-                        if(found.size() > 1 and std::find(found.begin(), found.end(), item) != found.end()) continue;
-                        found.emplace_back(item);
-                    }
-                }
-                auto [it, ok] = cache.insert(searchQuery);
-                it->result    = found;
-                // Now we have built a cache hit. Add it to results
-                for(auto &item : it->result) {
-                    if(result.size() > 1 and std::find(result.begin(), result.end(), item) != result.end()) continue;
-                    result.emplace_back(item);
+                for(auto &item : srcIndex.find_groups(key, root, hits, depth)) {
+                    if(not text::endsWith(item, key)) continue;
+                    if(found.size() > 1 and std::find(found.begin(), found.end(), item) != found.end()) continue;
+                    found.emplace_back(item);
                 }
             }
-            tools::logger::log->trace("Search: key [{}] | result [{}]{}", key, result, cacheMsg);
+            for(auto &item : found) {
+                if(result.size() > 1 and std::find(result.begin(), result.end(), item) != result.end()) continue;
+                result.emplace_back(item);
+            }
+            tools::logger::log->trace("Search: key [{}] | result [{}]", key, result);
         }
         return result;
     }
+
     template<typename T>
-    std::vector<ModelKey> loadModel(const h5pp::File &h5_src, std::unordered_map<std::string, ModelId<T>> &srcModelDb, const std::vector<ModelKey> &srcKeys) {
+    std::vector<ModelKey> loadModel(const h5pp::File &h5_src, const LinkIndex &srcIndex, std::unordered_map<std::string, ModelId<T>> &srcModelDb,
+                                    const std::vector<ModelKey> &srcKeys) {
         auto                  t_scope = tid::tic_scope(__FUNCTION__);
         std::vector<ModelKey> keys;
         for(const auto &srcKey : srcKeys) {
             auto path = fmt::format("{}/{}/{}", srcKey.algo, srcKey.model, srcKey.name);
             auto key  = fmt::format("{}|{}", h5pp::fs::path(h5_src.getFilePath()).parent_path(), path);
-            if(srcModelDb.find(key) == srcModelDb.end() and h5_src.linkExists(path)) {
+            if(srcModelDb.find(key) == srcModelDb.end() and srcIndex.exists(path)) {
                 // Copy the model from the attributes in h5_src to a struct ModelId
                 srcModelDb[key]   = ModelId<T>();
                 auto &srcModelId  = srcModelDb[key];
@@ -205,9 +416,9 @@ namespace tools::h5io {
         }
         return keys;
     }
-    template std::vector<ModelKey> loadModel(const h5pp::File &h5_src, std::unordered_map<std::string, ModelId<sdual>> &srcModelDb,
+    template std::vector<ModelKey> loadModel(const h5pp::File &h5_src, const LinkIndex &srcIndex, std::unordered_map<std::string, ModelId<sdual>> &srcModelDb,
                                              const std::vector<ModelKey> &srcKeys);
-    template std::vector<ModelKey> loadModel(const h5pp::File &h5_src, std::unordered_map<std::string, ModelId<lbit>> &srcModelDb,
+    template std::vector<ModelKey> loadModel(const h5pp::File &h5_src, const LinkIndex &srcIndex, std::unordered_map<std::string, ModelId<lbit>> &srcModelDb,
                                              const std::vector<ModelKey> &srcKeys);
 
     template<typename T>
@@ -275,8 +486,8 @@ namespace tools::h5io {
     template void saveModel(const h5pp::File &h5_src, h5pp::File &h5_tgt, std::unordered_map<std::string, InfoId<h5pp::TableInfo>> &tgtModelDb,
                             const ModelId<lbit> &modelId, const FileId &fileId);
 
-    std::vector<DsetKey> gatherDsetKeys(const h5pp::File &h5_src, std::unordered_map<std::string, h5pp::DsetInfo> &srcDsetDb, const PathId &pathid,
-                                        const std::vector<DsetKey> &srcKeys) {
+    std::vector<DsetKey> gatherDsetKeys(const h5pp::File &h5_src, const LinkIndex &srcIndex, std::unordered_map<std::string, h5pp::DsetInfo> &srcDsetDb,
+                                        const PathId &pathid, const std::vector<DsetKey> &srcKeys) {
         auto                 t_scope = tid::tic_scope(__FUNCTION__);
         std::vector<DsetKey> keys;
 
@@ -294,7 +505,7 @@ namespace tools::h5io {
             auto path = fmt::format("{}/{}", pathid.src_path, srcKey.name);
             auto key  = fmt::format("{}|{}", srcParentPath, path);
             if(srcDsetDb.find(key) == srcDsetDb.end()) {
-                srcDsetDb[key] = h5_src.getDatasetInfo(path);
+                srcDsetDb[key] = srcIndex.is_dataset(path) ? h5_src.getDatasetInfo(path) : internal::missingDsetInfo(path);
                 if(srcDsetDb[key].dsetExists.value()) tools::logger::log->debug("Detected new source dataset {}", key);
             } else {
                 auto t_read = tid::tic_scope("readDsetInfo");
@@ -305,12 +516,12 @@ namespace tools::h5io {
                 srcInfo.h5File     = h5_src.openFileHandle();
                 srcInfo.h5Dset     = std::nullopt;
                 srcInfo.h5Space    = std::nullopt;
-                srcInfo.dsetExists = std::nullopt;
+                srcInfo.dsetExists = srcIndex.is_dataset(path);
                 srcInfo.dsetSize   = std::nullopt;
                 srcInfo.dsetDims   = std::nullopt;
                 srcInfo.dsetByte   = std::nullopt;
                 srcInfo.dsetPath   = path;
-                h5pp::scan::readDsetInfo(srcInfo, srcInfo.h5File.value(), options, h5_src.plists);
+                if(srcInfo.dsetExists.value()) h5pp::scan::readDsetInfo(srcInfo, srcInfo.h5File.value(), options, h5_src.plists);
             }
             auto &srcInfo = srcDsetDb[key];
             if(srcInfo.dsetExists and srcInfo.dsetExists.value()) {
@@ -323,8 +534,8 @@ namespace tools::h5io {
         return keys;
     }
 
-    std::vector<TableKey> gatherTableKeys(const h5pp::File &h5_src, std::unordered_map<std::string, h5pp::TableInfo> &srcTableDb, const PathId &pathid,
-                                          const std::vector<TableKey> &srcKeys) {
+    std::vector<TableKey> gatherTableKeys(const h5pp::File &h5_src, const LinkIndex &srcIndex, std::unordered_map<std::string, h5pp::TableInfo> &srcTableDb,
+                                          const PathId &pathid, const std::vector<TableKey> &srcKeys) {
         auto                  t_scope = tid::tic_scope(__FUNCTION__);
         std::vector<TableKey> keys;
         h5pp::Options         options;
@@ -342,7 +553,7 @@ namespace tools::h5io {
             auto key  = fmt::format("{}|{}", srcParentPath, path);
 
             if(srcTableDb.find(key) == srcTableDb.end()) {
-                srcTableDb[key] = h5_src.getTableInfo(path);
+                srcTableDb[key] = srcIndex.is_dataset(path) ? h5_src.getTableInfo(path) : internal::missingTableInfo(path);
                 if(srcTableDb[key].tableExists.value()) tools::logger::log->debug("Detected new source table {}", key);
             } else {
                 auto t_read = tid::tic_scope("readTableInfo");
@@ -353,9 +564,9 @@ namespace tools::h5io {
                 srcInfo.h5File      = h5_src.openFileHandle();
                 srcInfo.h5Dset      = std::nullopt;
                 srcInfo.numRecords  = std::nullopt;
-                srcInfo.tableExists = std::nullopt;
+                srcInfo.tableExists = srcIndex.is_dataset(path);
                 srcInfo.tablePath   = path;
-                h5pp::scan::readTableInfo(srcInfo, srcInfo.h5File.value(), options, h5_src.plists);
+                if(srcInfo.tableExists.value()) h5pp::scan::readTableInfo(srcInfo, srcInfo.h5File.value(), options, h5_src.plists);
             }
 
             auto &srcInfo = srcTableDb[key];
@@ -370,8 +581,8 @@ namespace tools::h5io {
         return keys;
     }
 
-    std::vector<CronoKey> gatherCronoKeys(const h5pp::File &h5_src, std::unordered_map<std::string, h5pp::TableInfo> &srcTableDb, const PathId &pathid,
-                                          const std::vector<CronoKey> &srcKeys) {
+    std::vector<CronoKey> gatherCronoKeys(const h5pp::File &h5_src, const LinkIndex &srcIndex, std::unordered_map<std::string, h5pp::TableInfo> &srcTableDb,
+                                          const PathId &pathid, const std::vector<CronoKey> &srcKeys) {
         auto                  t_scope = tid::tic_scope(__FUNCTION__);
         std::vector<CronoKey> keys;
         h5pp::Options         options;
@@ -389,7 +600,7 @@ namespace tools::h5io {
             auto key  = fmt::format("{}|{}", srcParentPath, path);
 
             if(srcTableDb.find(key) == srcTableDb.end()) {
-                srcTableDb[key] = h5_src.getTableInfo(path);
+                srcTableDb[key] = srcIndex.is_dataset(path) ? h5_src.getTableInfo(path) : internal::missingTableInfo(path);
                 if(srcTableDb[key].tableExists.value()) tools::logger::log->debug("Detected new source crono {}", key);
             } else {
                 auto t_read = tid::tic_scope("readTableInfo");
@@ -401,9 +612,9 @@ namespace tools::h5io {
                 srcInfo.h5File      = h5_src.openFileHandle();
                 srcInfo.h5Dset      = std::nullopt;
                 srcInfo.numRecords  = std::nullopt;
-                srcInfo.tableExists = std::nullopt;
+                srcInfo.tableExists = srcIndex.is_dataset(path);
                 srcInfo.tablePath   = path;
-                h5pp::scan::readTableInfo(srcInfo, srcInfo.h5File.value(), options, h5_src.plists);
+                if(srcInfo.tableExists.value()) h5pp::scan::readTableInfo(srcInfo, srcInfo.h5File.value(), options, h5_src.plists);
             }
 
             auto &srcInfo = srcTableDb[key];
@@ -416,8 +627,8 @@ namespace tools::h5io {
         }
         return keys;
     }
-    std::vector<ScaleKey> gatherScaleKeys(const h5pp::File &h5_src, std::unordered_map<std::string, h5pp::TableInfo> &srcTableDb, const PathId &pathid,
-                                          const std::vector<ScaleKey> &srcKeys) {
+    std::vector<ScaleKey> gatherScaleKeys(const h5pp::File &h5_src, const LinkIndex &srcIndex, std::unordered_map<std::string, h5pp::TableInfo> &srcTableDb,
+                                          const PathId &pathid, const std::vector<ScaleKey> &srcKeys) {
         auto                  t_scope = tid::tic_scope(__FUNCTION__);
         std::vector<ScaleKey> keys;
         h5pp::Options         options;
@@ -433,13 +644,13 @@ namespace tools::h5io {
             // The database srcTableDb  is used to keep track the TableInfo structs for found datasets.
 
             // scaleKeys should be a vector [ "chi_8", "chi_16", "chi_24" ...] with tables for each scaling measurement
-            auto scaleKeys = findKeys(h5_src, pathid.src_path, {srcKey.scale}, -1, 1);
+            auto scaleKeys = findKeys(srcIndex, pathid.src_path, {srcKey.scale}, -1, 1);
             for(const auto &scaleKey : scaleKeys) {
                 auto path = fmt::format("{}/{}/{}", pathid.src_path, scaleKey, srcKey.name);
                 auto key  = fmt::format("{}|{}", srcParentPath, path);
                 auto chi  = tools::parse::extract_parameter_from_path<size_t>(path, "chi_");
                 if(srcTableDb.find(key) == srcTableDb.end()) {
-                    srcTableDb[key] = h5_src.getTableInfo(path);
+                    srcTableDb[key] = srcIndex.is_dataset(path) ? h5_src.getTableInfo(path) : internal::missingTableInfo(path);
                     if(srcTableDb[key].tableExists.value()) tools::logger::log->debug("Detected new source scale {}", key);
                 } else {
                     auto t_read = tid::tic_scope("readTableInfo");
@@ -451,9 +662,9 @@ namespace tools::h5io {
                     srcInfo.h5File      = h5_src.openFileHandle();
                     srcInfo.h5Dset      = std::nullopt;
                     srcInfo.numRecords  = std::nullopt;
-                    srcInfo.tableExists = std::nullopt;
+                    srcInfo.tableExists = srcIndex.is_dataset(path);
                     srcInfo.tablePath   = path;
-                    h5pp::scan::readTableInfo(srcInfo, srcInfo.h5File.value(), options, h5_src.plists);
+                    if(srcInfo.tableExists.value()) h5pp::scan::readTableInfo(srcInfo, srcInfo.h5File.value(), options, h5_src.plists);
                 }
 
                 auto &srcInfo = srcTableDb[key];
@@ -473,6 +684,10 @@ namespace tools::h5io {
                           std::unordered_map<std::string, h5pp::DsetInfo> &srcDsetDb, const PathId &pathid, const std::vector<DsetKey> &srcDsetKeys,
                           const FileId &fileId) {
         auto t_scope = tid::tic_scope(__FUNCTION__);
+        // Contiguous datasets are read up front, straight from the file, with a few large reads instead of one H5Dread each
+        std::vector<std::string> rawKeys;
+        for(const auto &srcKey : srcDsetKeys) rawKeys.emplace_back(srcKey.key);
+        auto rawData = tools::h5raw::read_dsets(h5_src.openFileHandle(), srcDsetDb, rawKeys);
         for(const auto &srcKey : srcDsetKeys) {
             if(srcDsetDb.find(srcKey.key) == srcDsetDb.end()) throw std::logic_error(h5pp::format("Key [{}] was not found in source map", srcKey.key));
             auto &srcInfo = srcDsetDb[srcKey.key];
@@ -506,7 +721,8 @@ namespace tools::h5io {
             // Determine the target index where to copy this record
             hsize_t index = tgtId.get_index(fileId.seed); // Positive if it has been read already
             index         = index != std::numeric_limits<hsize_t>::max() ? index : tgtInfo.dsetDims.value().at(srcKey.axis);
-            internal::copy_dset(h5_tgt, h5_src, tgtInfo, srcInfo, index, srcKey.axis);
+            auto raw = rawData.find(srcKey.key);
+            internal::copy_dset(h5_tgt, h5_src, tgtInfo, srcInfo, index, srcKey.axis, raw != rawData.end() ? &raw->second : nullptr);
 
             // Update the database
             tgtId.insert(fileId.seed, index);
@@ -547,18 +763,32 @@ namespace tools::h5io {
     }
 
     void transferCronos(h5pp::File &h5_tgt, std::unordered_map<std::string, InfoId<BufferedTableInfo>> &tgtTableDb,
-                        std::unordered_map<std::string, h5pp::TableInfo> &srcTableDb, const PathId &pathid, const std::vector<CronoKey> &srcCronoKeys,
-                        const FileId &fileId, const FileStats &fileStats) {
+                        std::unordered_map<std::string, ProgressId> &tgtProgressDb, std::unordered_map<std::string, h5pp::TableInfo> &srcTableDb,
+                        const PathId &pathid, const std::vector<CronoKey> &srcCronoKeys, const FileId &fileId, const FileStats &fileStats) {
         // In this function we take time series data from each srcTable and create multiple tables tgtTable, one for each
         // time point (iteration). Each entry in tgtTable corresponds to the same time point on different realizations.
-        auto                   t_scope = tid::tic_scope(__FUNCTION__);
+        auto                   t_scope       = tid::tic_scope(__FUNCTION__);
+        constexpr size_t       maxBlockBytes = 8 * 1024 * 1024; // Source records are read in blocks of at most this size
         std::vector<std::byte> srcReadBuffer;
-        std::vector<size_t>    iters; // We can assume all tables have the same iteration numbers. Only update on mismatch
+        std::vector<size_t>    iters;          // We can assume all tables have the same iteration numbers. Only update on mismatch
+        size_t                 itersBegin = 0; // iters holds the iteration numbers of records [itersBegin, itersBegin + iters.size())
         for(const auto &srcKey : srcCronoKeys) {
             if(srcTableDb.find(srcKey.key) == srcTableDb.end()) throw std::logic_error(h5pp::format("Key [{}] was not found in source map", srcKey.key));
-            auto &srcInfo    = srcTableDb[srcKey.key];
-            auto  srcRecords = srcInfo.numRecords.value();
-            tools::logger::log->trace("Transferring crono table {} record {}", srcRecords, srcInfo.tablePath.value());
+            auto  &srcInfo      = srcTableDb[srcKey.key];
+            auto   srcRecords   = srcInfo.numRecords.value();
+            auto   recordBytes  = srcInfo.recordBytes.value();
+            size_t blockRecords = std::max<size_t>(1, maxBlockBytes / recordBytes);
+            size_t blockBegin   = 0;
+            size_t blockSize    = 0; // Records [blockBegin, blockBegin + blockSize) are in srcReadBuffer
+            auto   tgtName      = h5pp::fs::path(srcInfo.tablePath.value()).filename().string();
+
+            // A simulation that is still running appends records to its tables. The ones merged last time are already in the cronos,
+            // so only the tail is read. If the table has shrunk, e.g. because the simulation was restarted, it is read from the start.
+            auto  &progress = tools::h5db::getProgress(h5_tgt, tgtProgressDb, pathid.progress_path(tgtName));
+            size_t recBegin = progress.get_count(fileId.seed);
+            if(recBegin > srcRecords) recBegin = 0;
+            if(recBegin == srcRecords) continue;
+            tools::logger::log->trace("Transferring crono table {} records [{}, {})", srcInfo.tablePath.value(), recBegin, srcRecords);
 
             // Iterate over all table elements. These should be a time series measured at every iteration
             // Note that there could in principle exist duplicate entries, which is why we can't trust the
@@ -566,16 +796,16 @@ namespace tools::h5io {
             // Try getting the iteration number, which is more accurate.
 
             try {
-                if(iters.size() != srcRecords) { // Update iteration numbers if it's not the same that we have already.
+                if(itersBegin != recBegin or iters.size() != srcRecords - recBegin) { // Update iteration numbers if it's not the same that we have already.
                     auto t_read = tid::tic_scope("readTableField");
-                    h5pp::hdf5::readTableField(iters, srcInfo, {"iter"});
+                    h5pp::hdf5::readTableField(iters, srcInfo, {"iter"}, recBegin, srcRecords - recBegin);
+                    itersBegin = recBegin;
                     if(iters.empty()) tools::logger::log->warn("column [iter] does not exist in table [{}]", srcInfo.tablePath.value());
                 }
             } catch(const std::exception &ex) { throw std::logic_error(fmt::format("Failed to get iteration numbers: {}", ex.what())); }
-            for(size_t rec = 0; rec < srcRecords; rec++) {
+            for(size_t rec = recBegin; rec < srcRecords; rec++) {
                 size_t iter = rec;
-                if(not iters.empty()) iter = iters[rec]; // Get the actual iteration number
-                auto tgtName = h5pp::fs::path(srcInfo.tablePath.value()).filename().string();
+                if(not iters.empty()) iter = iters[rec - recBegin]; // Get the actual iteration number
                 auto tgtPath = pathid.crono_path(tgtName, iter);
 
                 if(tgtTableDb.find(tgtPath) == tgtTableDb.end()) {
@@ -616,11 +846,16 @@ namespace tools::h5io {
 
                 index = index != std::numeric_limits<hsize_t>::max() ? index : static_cast<hsize_t>(fileStats.count - 1);
 
-                // read a source record at "iter" into the "index" position in the buffer
-                auto t_buffer = tid::tic_scope("bufferCronoRecords");
-                srcReadBuffer.resize(srcInfo.recordBytes.value());
-                h5pp::hdf5::readTableRecords(srcReadBuffer, srcInfo, rec, 1);
-                tgtBuff.insert(srcReadBuffer, index);
+                // Read the source records from rec onward in one call, instead of one call per record
+                if(rec < blockBegin or rec >= blockBegin + blockSize) {
+                    auto t_read = tid::tic_scope("readTableRecords");
+                    blockBegin  = rec;
+                    blockSize   = std::min<size_t>(blockRecords, srcRecords - rec);
+                    srcReadBuffer.resize(blockSize * recordBytes);
+                    h5pp::hdf5::readTableRecords(srcReadBuffer, srcInfo, blockBegin, blockSize);
+                }
+                // Copy the source record at "iter" into the "index" position in the buffer
+                tgtBuff.insert(srcReadBuffer.data() + (rec - blockBegin) * recordBytes, recordBytes, index);
 
                 // copy/append a source record at "iter" into the "index" position on the table.
                 //                tools::logger::log->trace("Copying crono index {} -> {}: {}", rec, index, tgtPath);
@@ -629,6 +864,83 @@ namespace tools::h5io {
                 // Update the database
                 tgtId.insert(fileId.seed, index);
             }
+            progress.set_count(fileId.seed, srcRecords);
+        }
+    }
+
+    void transferCronos2d(h5pp::File &h5_tgt, std::unordered_map<std::string, InfoId<h5pp::DsetInfo>> &tgtDsetDb,
+                          std::unordered_map<std::string, ProgressId> &tgtProgressDb, std::unordered_map<std::string, h5pp::TableInfo> &srcTableDb,
+                          const PathId &pathid, const std::vector<CronoKey> &srcCronoKeys, const FileId &fileId, const FileStats &fileStats) {
+        // In this function we take the time series in each srcTable and write it into the column of this realization
+        // in a single [iteration x seed] dataset, instead of one record into each of many per-iteration tables as in transferCronos.
+        auto                   t_scope       = tid::tic_scope(__FUNCTION__);
+        constexpr size_t       maxBlockBytes = 8 * 1024 * 1024; // Source records are read in blocks of at most this size
+        std::vector<std::byte> srcReadBuffer;
+        std::vector<size_t>    iters;          // We can assume all tables have the same iteration numbers. Only update on mismatch
+        size_t                 itersBegin = 0; // iters holds the iteration numbers of records [itersBegin, itersBegin + iters.size())
+        for(const auto &srcKey : srcCronoKeys) {
+            if(srcTableDb.find(srcKey.key) == srcTableDb.end()) throw std::logic_error(h5pp::format("Key [{}] was not found in source map", srcKey.key));
+            auto  &srcInfo      = srcTableDb[srcKey.key];
+            auto   srcRecords   = srcInfo.numRecords.value();
+            auto   recordBytes  = srcInfo.recordBytes.value();
+            size_t blockRecords = std::max<size_t>(1, maxBlockBytes / recordBytes);
+            auto   tgtName      = h5pp::fs::path(srcInfo.tablePath.value()).filename().string();
+            auto   tgtPath      = pathid.crono2d_path(tgtName);
+
+            // Only the records appended since the last merge of this seed are new, as in transferCronos
+            auto  &progress = tools::h5db::getProgress(h5_tgt, tgtProgressDb, pathid.crono2d_progress_path(tgtName));
+            size_t recBegin = progress.get_count(fileId.seed);
+            if(recBegin > srcRecords) recBegin = 0;
+            if(recBegin == srcRecords) continue;
+            tools::logger::log->trace("Transferring crono2d table {} records [{}, {})", srcInfo.tablePath.value(), recBegin, srcRecords);
+
+            try {
+                if(itersBegin != recBegin or iters.size() != srcRecords - recBegin) { // Update iteration numbers if it's not the same that we have already.
+                    auto t_read = tid::tic_scope("readTableField");
+                    h5pp::hdf5::readTableField(iters, srcInfo, {"iter"}, recBegin, srcRecords - recBegin);
+                    itersBegin = recBegin;
+                    if(iters.empty()) tools::logger::log->warn("column [iter] does not exist in table [{}]", srcInfo.tablePath.value());
+                }
+            } catch(const std::exception &ex) { throw std::logic_error(fmt::format("Failed to get iteration numbers: {}", ex.what())); }
+            auto iter_of = [&](size_t rec) { return iters.empty() ? rec : iters[rec - recBegin]; };
+
+            if(tgtDsetDb.find(tgtPath) == tgtDsetDb.end()) {
+                auto t_create = tid::tic_scope("createDataset");
+                tools::logger::log->debug("Adding target crono2d {}", tgtPath);
+                h5pp::DsetInfo dsetInfo = h5_tgt.getDatasetInfo(tgtPath);
+                if(not dsetInfo.dsetExists.value()) {
+                    // A chunk holds the time series of a few seeds, up to about crono2d_chunk_bytes
+                    auto maxIters   = std::max<size_t>(1, internal::crono2d_chunk_bytes / (recordBytes * internal::crono2d_chunk_seeds));
+                    auto chunkIters = static_cast<hsize_t>(std::clamp<size_t>(srcRecords, 1, maxIters));
+                    dsetInfo        = h5_tgt.createDataset(tgtPath, srcInfo.h5Type.value(), H5D_CHUNKED, std::vector<hsize_t>{0, 0},
+                                                           std::vector<hsize_t>{chunkIters, internal::crono2d_chunk_seeds});
+                }
+                tgtDsetDb[tgtPath] = dsetInfo;
+            }
+            auto &tgtId   = tgtDsetDb[tgtPath];
+            auto &tgtInfo = tgtId.info;
+            internal::cache_crono2d(h5_tgt, tgtInfo);
+
+            // The column of this realization. Like the index in transferCronos, it is shared by all cronos of the same source file
+            hsize_t col = tgtId.get_index(fileId.seed); // Positive if it has been read already
+            col         = col != std::numeric_limits<hsize_t>::max() ? col : static_cast<hsize_t>(fileStats.count - 1);
+
+            // Records of consecutive iterations go into consecutive rows, so the whole time series is usually written with one hyperslab.
+            // A gap or a repeated iteration number starts a new run. A repeated iteration overwrites the row with the later record.
+            for(size_t runBegin = recBegin, runEnd = recBegin; runBegin < srcRecords; runBegin = runEnd) {
+                runEnd = runBegin + 1;
+                while(runEnd < srcRecords and runEnd - runBegin < blockRecords and iter_of(runEnd) == iter_of(runEnd - 1) + 1) runEnd++;
+                {
+                    auto t_read = tid::tic_scope("readTableRecords");
+                    srcReadBuffer.resize((runEnd - runBegin) * recordBytes);
+                    h5pp::hdf5::readTableRecords(srcReadBuffer, srcInfo, runBegin, runEnd - runBegin);
+                }
+                auto t_write = tid::tic_scope("writeColumn");
+                internal::write_crono2d(tgtInfo, srcReadBuffer.data(), iter_of(runBegin), runEnd - runBegin, col, 1);
+            }
+            // Update the database
+            tgtId.insert(fileId.seed, col);
+            progress.set_count(fileId.seed, srcRecords);
         }
     }
 
@@ -694,63 +1006,121 @@ namespace tools::h5io {
     }
 
     template<typename ModelType>
-    void merge(h5pp::File &h5_tgt, const h5pp::File &h5_src, const FileId &fileId, const FileStats &fileStats, const tools::h5db::Keys &keys,
-               tools::h5db::TgtDb &tgtdb) {
+    void merge(h5pp::File &h5_tgt, const h5pp::File &h5_src, const LinkIndex &srcIndex, const FileId &fileId, const FileStats &fileStats,
+               const tools::h5db::Keys &keys, tools::h5db::TgtDb &tgtdb) {
         auto t_scope = tid::tic_scope(__FUNCTION__);
         // Define reusable source Info
-        static tools::h5db::SrcDb<ModelId<ModelType>> srcdb;
-        h5pp::fs::path                                parent_path = h5pp::fs::path(h5_src.getFilePath()).parent_path();
-        if(srcdb.parent_path != parent_path) {
+        static std::unordered_map<std::string, tools::h5db::SrcDb<ModelId<ModelType>>> srcdbs;
+        h5pp::fs::path parent_path = h5pp::fs::path(h5_src.getFilePath()).parent_path();
+        if(not keep_srcdb and srcdbs.find(parent_path) == srcdbs.end()) {
             // Clear when moving to another set of seeds (new point on the phase diagram)
-            srcdb.clear();
-            srcdb.parent_path = parent_path;
-        }
-
-        // Start finding the required components in the source
-        auto groups = tools::h5io::findKeys(h5_src, "/", keys.get_algos(), -1, 0);
-        for(const auto &algo : groups) {
-            // Start by extracting the model
-            auto modelKeys = tools::h5io::loadModel(h5_src, srcdb.model, keys.models);
-            if(modelKeys.size() != 1) throw std::runtime_error("Exactly 1 model has to be loaded into keys");
-            auto &modelId = srcdb.model[modelKeys.back().key];
-            // Save the model to file if it hasn't
-            tools::h5io::saveModel(h5_src, h5_tgt, tgtdb.model, modelId, fileId);
-            auto tgt_base = modelId.basepath;
-            // Next search for tables and datasets in the source file
-            // and transfer them to the target file
-            auto state_groups = tools::h5io::findKeys(h5_src, algo, keys.get_states(), -1, 0);
-            for(const auto &state : state_groups) {
-                auto point_groups = tools::h5io::findKeys(h5_src, fmt::format("{}/{}", algo, state), keys.get_points(), -1, 1);
-                for(const auto &point : point_groups) {
-                    auto pathid = PathId(tgt_base, algo, state, point);
-                    // Try gathering all the tables
-                    try {
-                        auto t_dset   = tid::tic_scope("dset");
-                        auto dsetKeys = tools::h5io::gatherDsetKeys(h5_src, srcdb.dset, pathid, keys.dsets);
-                        tools::h5io::transferDatasets(h5_tgt, tgtdb.dset, h5_src, srcdb.dset, pathid, dsetKeys, fileId);
-                    } catch(const std::runtime_error &ex) { tools::logger::log->warn("Dset transfer failed in [{}]: {}", pathid.src_path, ex.what()); }
+            srcdbs.clear();
+        }
+        auto &srcdb       = srcdbs[parent_path];
+        srcdb.parent_path = parent_path;
 
-                    try {
-                        auto t_table   = tid::tic_scope("table");
-                        auto tableKeys = tools::h5io::gatherTableKeys(h5_src, srcdb.table, pathid, keys.tables);
-                        tools::h5io::transferTables(h5_tgt, tgtdb.table, srcdb.table, pathid, tableKeys, fileId);
-                    } catch(const std::runtime_error &ex) { tools::logger::log->error("Table transfer failed in [{}]: {}", pathid.src_path, ex.what()); }
+        // Transfers the objects at one point. With a cached plan, the source objects are reopened first: they are known to exist
+        auto transferPoint = [&](const tools::h5db::MergePlan::Point &point, bool renew) {
+            const auto &pathid = point.pathid;
+            try {
+                auto t_dset = tid::tic_scope("dset");
+                if(renew)
+                    for(const auto &srcKey : point.dsets) internal::renewDsetInfo(h5_src, srcdb.dset.at(srcKey.key));
+                tools::h5io::transferDatasets(h5_tgt, tgtdb.dset, h5_src, srcdb.dset, pathid, point.dsets, fileId);
+            } catch(const std::runtime_error &ex) { tools::logger::log->warn("Dset transfer failed in [{}]: {}", pathid.src_path, ex.what()); }
 
-                    try {
-                        auto t_crono   = tid::tic_scope("crono");
-                        auto cronoKeys = tools::h5io::gatherCronoKeys(h5_src, srcdb.crono, pathid, keys.cronos);
-                        tools::h5io::transferCronos(h5_tgt, tgtdb.crono, srcdb.crono, pathid, cronoKeys, fileId, fileStats);
-                    } catch(const std::runtime_error &ex) { tools::logger::log->error("Crono transfer failed in[{}]: {}", pathid.src_path, ex.what()); }
-                    try {
-                        auto t_scale   = tid::tic_scope("scale");
-                        auto scaleKeys = tools::h5io::gatherScaleKeys(h5_src, srcdb.scale, pathid, keys.scales);
-                        tools::h5io::transferScales(h5_tgt, tgtdb.scale, srcdb.scale, pathid, scaleKeys, fileId, fileStats);
-                    } catch(const std::runtime_error &ex) { tools::logger::log->error("Scale transfer failed in[{}]: {}", pathid.src_path, ex.what()); }
+            try {
+                auto t_table = tid::tic_scope("table");
+                if(renew)
+                    for(const auto &srcKey : point.tables) internal::renewTableInfo(h5_src, srcdb.table.at(srcKey.key));
+                tools::h5io::transferTables(h5_tgt, tgtdb.table, srcdb.table, pathid, point.tables, fileId);
+            } catch(const std::runtime_error &ex) { tools::logger::log->error("Table transfer failed in [{}]: {}", pathid.src_path, ex.what()); }
+
+            try {
+                auto t_crono = tid::tic_scope("crono");
+                if(renew)
+                    for(const auto &srcKey : point.cronos) internal::renewTableInfo(h5_src, srcdb.crono.at(srcKey.key));
+                if(tools::h5io::crono2d)
+                    tools::h5io::transferCronos2d(h5_tgt, tgtdb.crono2d, tgtdb.progress, srcdb.crono, pathid, point.cronos, fileId, fileStats);
+                else
+                    tools::h5io::transferCronos(h5_tgt, tgtdb.crono, tgtdb.progress, srcdb.crono, pathid, point.cronos, fileId, fileStats);
+            } catch(const std::runtime_error &ex) { tools::logger::log->error("Crono transfer failed in[{}]: {}", pathid.src_path, ex.what()); }
+            try {
+                auto t_scale = tid::tic_scope("scale");
+                if(renew)
+                    for(const auto &srcKey : point.scales) internal::renewTableInfo(h5_src, srcdb.scale.at(srcKey.key));
+                tools::h5io::transferScales(h5_tgt, tgtdb.scale, srcdb.scale, pathid, point.scales, fileId, fileStats);
+            } catch(const std::runtime_error &ex) { tools::logger::log->error("Scale transfer failed in[{}]: {}", pathid.src_path, ex.what()); }
+        };
+
+        // Seeds in a directory share their layout, so the keys are usually found in the first file only
+        auto signature = srcIndex.get_signature(keys);
+        if(auto cached = srcdb.plan.find(signature); cached != srcdb.plan.end()) {
+            auto        t_plan = tid::tic_scope("plan");
+            const auto &plan   = cached->second;
+            tools::h5io::saveModel(h5_src, h5_tgt, tgtdb.model, srcdb.model.at(plan.modelKey), fileId);
+            for(const auto &point : plan.points) transferPoint(point, true);
+        } else {
+            tools::h5db::MergePlan plan;
+            bool                   complete = true; // Only cache a plan if all the keys were found without errors
+            // Start finding the required components in the source
+            auto groups = tools::h5io::findKeys(srcIndex, "/", keys.get_algos(), -1, 0);
+            for(const auto &algo : groups) {
+                // Start by extracting the model
+                auto modelKeys = tools::h5io::loadModel(h5_src, srcIndex, srcdb.model, keys.models);
+                if(modelKeys.size() != 1) throw std::runtime_error("Exactly 1 model has to be loaded into keys");
+                auto &modelId = srcdb.model[modelKeys.back().key];
+                plan.modelKey = modelKeys.back().key;
+                // Save the model to file if it hasn't
+                tools::h5io::saveModel(h5_src, h5_tgt, tgtdb.model, modelId, fileId);
+                auto tgt_base = modelId.basepath;
+                // Next search for tables and datasets in the source file
+                // and transfer them to the target file
+                auto state_groups = tools::h5io::findKeys(srcIndex, algo, keys.get_states(), -1, 0);
+                for(const auto &state : state_groups) {
+                    auto point_groups = tools::h5io::findKeys(srcIndex, fmt::format("{}/{}", algo, state), keys.get_points(), -1, 1);
+                    for(const auto &point : point_groups) {
+                        auto &planPoint = plan.points.emplace_back(tools::h5db::MergePlan::Point{PathId(tgt_base, algo, state, point), {}, {}, {}, {}});
+                        const auto &pathid = planPoint.pathid;
+                        // Try gathering all the tables
+                        try {
+                            planPoint.dsets = tools::h5io::gatherDsetKeys(h5_src, srcIndex, srcdb.dset, pathid, keys.dsets);
+                        } catch(const std::runtime_error &ex) {
+                            complete = false;
+                            tools::logger::log->warn("Dset transfer failed in [{}]: {}", pathid.src_path, ex.what());
+                        }
+                        try {
+                            planPoint.tables = tools::h5io::gatherTableKeys(h5_src, srcIndex, srcdb.table, pathid, keys.tables);
+                        } catch(const std::runtime_error &ex) {
+                            complete = false;
+                            tools::logger::log->error("Table transfer failed in [{}]: {}", pathid.src_path, ex.what());
+                        }
+                        try {
+                            planPoint.cronos = tools::h5io::gatherCronoKeys(h5_src, srcIndex, srcdb.crono, pathid, keys.cronos);
+                        } catch(const std::runtime_error &ex) {
+                            complete = false;
+                            tools::logger::log->error("Crono transfer failed in[{}]: {}", pathid.src_path, ex.what());
+                        }
+                        try {
+                            planPoint.scales = tools::h5io::gatherScaleKeys(h5_src, srcIndex, srcdb.scale, pathid, keys.scales);
+                        } catch(const std::runtime_error &ex) {
+                            complete = false;
+                            tools::logger::log->error("Scale transfer failed in[{}]: {}", pathid.src_path, ex.what());
+                        }
+                        transferPoint(planPoint, false);
+                    }
                 }
             }
+            if(complete and not plan.modelKey.empty()) {
+                // Files of one directory rarely have more than a few layouts. If they do, e.g. because the signature sees every seed
+                // as different, start over rather than keep a plan for each file
+                if(srcdb.plan.size() >= tools::h5db::MergePlan::max_cached) srcdb.plan.clear();
+                srcdb.plan.emplace(signature, std::move(plan));
+            }
         }
 
         auto t_close = tid::tic_scope("close");
+        srcdb.release();
 
         // Check that there are no errors hiding in the HDF5 error-stack
         auto num_errors = H5Eget_num(H5E_DEFAULT);
@@ -759,10 +1129,160 @@ namespace tools::h5io {
             throw std::runtime_error(fmt::format("Error when treating file [{}]", h5_src.getFilePath()));
         }
     }
-    template void merge<sdual>(h5pp::File &h5_tgt, const h5pp::File &h5_src, const FileId &fileId, const FileStats &fileStats, const tools::h5db::Keys &keys,
-                               tools::h5db::TgtDb &tgtdb);
-    template void merge<lbit>(h5pp::File &h5_tgt, const h5pp::File &h5_src, const FileId &fileId, const FileStats &fileStats, const tools::h5db::Keys &keys,
-                              tools::h5db::TgtDb &tgtdb);
+    template void merge<sdual>(h5pp::File &h5_tgt, const h5pp::File &h5_src, const LinkIndex &srcIndex, const FileId &fileId, const FileStats &fileStats,
+                               const tools::h5db::Keys &keys, tools::h5db::TgtDb &tgtdb);
+    template void merge<lbit>(h5pp::File &h5_tgt, const h5pp::File &h5_src, const LinkIndex &srcIndex, const FileId &fileId, const FileStats &fileStats,
+                              const tools::h5db::Keys &keys, tools::h5db::TgtDb &tgtdb);
+
+    void mergePartial(h5pp::File &h5_tgt, tools::h5db::TgtDb &tgtdb, const h5pp::File &h5_part, tools::h5db::TgtDb &partdb, const tools::h5db::Keys &keys) {
+        // Appends the partial target h5_part, made from another seed range of the same directory, to h5_tgt.
+        // Every object in h5_part either does not exist in h5_tgt yet and is copied as a whole, or its records are appended after those of h5_tgt.
+        // Either way the seed databases in partdb are carried over with their indices shifted by the records that were already in h5_tgt.
+        auto t_scope     = tid::tic_scope(__FUNCTION__);
+        auto tgtKeepOpen = h5_tgt.getFileHandleToken();
+        auto srcKeepOpen = h5_part.getFileHandleToken();
+        tools::logger::log->info("Merging partial target {} -> {}", h5_part.getFilePath(), h5_tgt.getFilePath());
+
+        for(const auto &[path, fileId] : partdb.file) tgtdb.file[path] = fileId;
+        for(const auto &[path, quarantineId] : partdb.quarantine) tgtdb.quarantine[path] = quarantineId;
+
+        for(auto &[key, partId] : partdb.model) {
+            // The model is common to all realizations in a directory, so one copy is enough
+            if(tgtdb.model.find(key) != tgtdb.model.end()) continue;
+            auto tablePath = partId.info.tablePath.value();
+            if(not h5_tgt.linkExists(tablePath)) internal::copy_link(h5_tgt, h5_part, h5pp::fs::path(tablePath).parent_path().string());
+            auto &tgtId = tgtdb.model[key];
+            tgtId       = h5_tgt.getTableInfo(tablePath);
+            for(const auto &[seed, index] : partId.get_db()) tgtId.insert(seed, index);
+        }
+
+        for(auto &[key, partId] : partdb.table) {
+            auto    tablePath = partId.info.tablePath.value();
+            hsize_t offset    = 0;
+            if(tgtdb.table.find(key) == tgtdb.table.end()) {
+                internal::copy_link(h5_tgt, h5_part, tablePath);
+                tgtdb.table[key] = h5_tgt.getTableInfo(tablePath);
+            } else {
+                auto                  &tgtInfo    = tgtdb.table[key].info;
+                auto                   numRecords = partId.info.numRecords.value();
+                std::vector<std::byte> buffer(numRecords * partId.info.recordBytes.value());
+                offset = tgtInfo.numRecords.value();
+                h5pp::hdf5::readTableRecords(buffer, partId.info, 0, numRecords);
+                h5pp::hdf5::writeTableRecords(buffer, tgtInfo, offset, numRecords);
+            }
+            auto &tgtId = tgtdb.table[key];
+            for(const auto &[seed, index] : partId.get_db()) tgtId.insert(seed, index + offset);
+        }
+
+        for(auto &[key, partId] : partdb.dset) {
+            auto    dsetPath = partId.info.dsetPath.value();
+            hsize_t offset   = 0;
+            if(tgtdb.dset.find(key) == tgtdb.dset.end()) {
+                internal::copy_link(h5_tgt, h5_part, dsetPath);
+                tgtdb.dset[key] = h5_tgt.getDatasetInfo(dsetPath);
+            } else {
+                auto dsetName = h5pp::fs::path(dsetPath).filename().string();
+                auto dsetKey  = std::find_if(keys.dsets.begin(), keys.dsets.end(), [&dsetName](const DsetKey &k) { return k.name == dsetName; });
+                if(dsetKey == keys.dsets.end()) throw std::runtime_error(h5pp::format("No dataset key matches [{}]", dsetPath));
+                auto &tgtInfo = tgtdb.dset[key].info;
+                offset        = tgtInfo.dsetDims.value().at(dsetKey->axis);
+                internal::copy_dset(h5_tgt, h5_part, tgtInfo, partId.info, offset, dsetKey->axis);
+            }
+            auto &tgtId = tgtdb.dset[key];
+            for(const auto &[seed, index] : partId.get_db()) tgtId.insert(seed, index + offset);
+        }
+
+        // Cronos and scales share one index per source file, so they are all shifted past the largest index in h5_tgt.
+        // The partial tables may have holes for files that lacked a record, so only the records listed in the seed database are copied.
+        hsize_t offset = 0;
+        for(auto *db : {&tgtdb.crono, &tgtdb.scale})
+            for(const auto &[key, tgtId] : *db)
+                for(const auto &[seed, index] : tgtId.get_db()) offset = std::max(offset, index + 1);
+        for(const auto &[key, tgtId] : tgtdb.crono2d)
+            for(const auto &[seed, index] : tgtId.get_db()) offset = std::max(offset, index + 1);
+
+        for(auto [partDb, tgtDb] : {std::make_pair(&partdb.crono, &tgtdb.crono), std::make_pair(&partdb.scale, &tgtdb.scale)}) {
+            for(auto &[key, partId] : *partDb) {
+                auto tablePath = partId.info.tablePath.value();
+                if(tgtDb->find(key) == tgtDb->end()) {
+                    auto            t_create  = tid::tic_scope("createTable");
+                    h5pp::TableInfo tableInfo = h5_tgt.getTableInfo(tablePath);
+                    if(not tableInfo.tableExists.value())
+                        tableInfo = h5_tgt.createTable(partId.info.h5Type.value(), tablePath, partId.info.tableTitle.value(), std::nullopt, true);
+                    (*tgtDb)[key] = tableInfo;
+                }
+                auto &tgtId       = (*tgtDb)[key];
+                auto  recordBytes = partId.info.recordBytes.value();
+                auto  numRecords  = partId.info.numRecords.value();
+
+                std::vector<std::byte> buffer(numRecords * recordBytes);
+                h5pp::hdf5::readTableRecords(buffer, partId.info, 0, numRecords);
+                std::vector<std::pair<hsize_t, long>> records; // Sorted by index, so that the buffer gets contiguous pieces
+                for(const auto &[seed, index] : partId.get_db()) records.emplace_back(index, seed);
+                std::sort(records.begin(), records.end());
+
+                auto                   t_buffer = tid::tic_scope("bufferCronoRecords");
+                std::vector<std::byte> record(recordBytes);
+                for(const auto &[index, seed] : records) {
+                    if(tgtId.has_index(seed)) continue; // Slices do not share seeds, but be safe
+                    if(index >= numRecords)
+                        throw std::runtime_error(h5pp::format("Index {} is out of range in [{}]: {} records", index, tablePath, numRecords));
+                    auto begin = buffer.begin() + static_cast<std::ptrdiff_t>(index * recordBytes);
+                    std::copy(begin, begin + static_cast<std::ptrdiff_t>(recordBytes), record.begin());
+                    tgtId.buff.insert(record, index + offset);
+                    tgtId.insert(seed, index + offset);
+                }
+                tgtId.buff.flush();
+            }
+        }
+
+        // The columns of a crono2d dataset are shifted like the indices of the cronos. The rows, or iterations, stay the same.
+        // The part is copied in blocks of whole chunk columns, and the columns of seeds it lacks are copied too: they hold the fill value anyway.
+        for(auto &[key, partId] : partdb.crono2d) {
+            auto dsetPath = partId.info.dsetPath.value();
+            if(tgtdb.crono2d.find(key) == tgtdb.crono2d.end()) {
+                auto           t_create = tid::tic_scope("createDataset");
+                h5pp::DsetInfo dsetInfo = h5_tgt.getDatasetInfo(dsetPath);
+                if(not dsetInfo.dsetExists.value())
+                    dsetInfo = h5_tgt.createDataset(dsetPath, partId.info.h5Type.value(), H5D_CHUNKED, std::vector<hsize_t>{0, 0},
+                                                    partId.info.dsetChunk.value());
+                tgtdb.crono2d[key] = dsetInfo;
+            }
+            auto &tgtId = tgtdb.crono2d[key];
+            internal::cache_crono2d(h5_tgt, tgtId.info);
+            auto                   partDims = partId.info.dsetDims.value();
+            auto                   stride   = partId.info.dsetChunk.value().at(1);
+            std::vector<std::byte> buffer;
+            for(hsize_t col = 0; partDims.at(0) > 0 and col < partDims.at(1); col += stride) {
+                auto cols = std::min(stride, partDims[1] - col);
+                internal::read_crono2d(partId.info, buffer, 0, partDims[0], col, cols);
+                internal::write_crono2d(tgtId.info, buffer.data(), 0, partDims[0], col + offset, cols);
+            }
+            for(const auto &[seed, index] : partId.get_db()) tgtId.insert(seed, index + offset);
+        }
+
+        // Carry over the number of crono records merged from each seed. There is one progress database per crono table name,
+        // next to the iter_* groups of its cronos, or next to its crono2d dataset
+        std::set<std::string> progressPaths;
+        for(const auto &[key, partId] : partdb.crono) {
+            auto tablePath = h5pp::fs::path(partId.info.tablePath.value());
+            progressPaths.insert((tablePath.parent_path().parent_path() / ".progress" / tablePath.filename()).string());
+        }
+        for(const auto &[key, partId] : partdb.crono2d) {
+            auto dsetPath = h5pp::fs::path(partId.info.dsetPath.value());
+            progressPaths.insert((dsetPath.parent_path() / ".progress" / dsetPath.filename()).string());
+        }
+        for(const auto &path : progressPaths) {
+            auto &partProgress = tools::h5db::getProgress(h5_part, partdb.progress, path);
+            auto &tgtProgress  = tools::h5db::getProgress(h5_tgt, tgtdb.progress, path);
+            for(const auto &[seed, count] : partProgress.get_db()) tgtProgress.set_count(seed, count);
+        }
+
+        // The merged target is only as complete as its parts
+        auto tgtManifest  = tools::h5db::loadManifest(h5_tgt);
+        auto partManifest = tools::h5db::loadManifest(h5_part);
+        if(tgtManifest and not(partManifest and partManifest.value() == tgtManifest.value())) tools::h5db::saveManifest(h5_tgt, ManifestId());
+    }
 
     void writeProfiling(h5pp::File &h5_tgt) {
         auto t_scope = tid::tic_scope(__FUNCTION__);
@@ -4,6 +4,7 @@
 #include <io/h5db.h>
 #include <io/id.h>
 #include <io/meta.h>
+#include <map>
 #include <set>
 #include <string>
 #include <unordered_map>
@@ -18,49 +19,117 @@ namespace tools::h5io {
 
     inline std::string tmp_path;
     inline std::string tgt_path;
+    inline bool        keep_srcdb = false; // Keep the source metadata of every directory in memory, instead of only the current one
+    inline bool        crono2d    = false; // Merge each crono table into one [iteration x seed] dataset, instead of one table per iteration
 
     std::string get_tmp_dirname(std::string_view exename);
 
+    /*! \brief Sets up fapl for opening a small source file read-only, as one of many
+     *
+     * The metadata cache starts small instead of at 2 MB, objects are evicted from it when they are closed,
+     * file locking is off and the library version bounds are the latest. The settings are made once and copied into each fapl.
+     * Locking costs a lock round trip per open on NFS and Lustre, and fails outright where locks are not supported.
+     * Without it, a source file may be read while a running simulation writes it: what is read then can be inconsistent,
+     * and the file is quarantined, or skipped as unfinished, until it changes. A setting that fails is logged and left out.
+     */
+    void setSourceProfile(hid_t fapl);
+
+    /*! \brief The objects in a source file, found in one H5Ovisit
+     *
+     * Searching with findGroups or checking with linkExists walks the file again for every query, and there are several per point.
+     * Instead, the path, type and token (address) of every object are read once after opening the file, and the queries are lookups in a map.
+     * The index also gives a hash of the layout, which keys the MergePlan cache: files from the same simulation have the same objects,
+     * and their types are assumed to be the same too, as they already are in SrcDb.
+     * An object with several hard links is listed under the first path visited. Soft and external links are not followed.
+     */
+    class LinkIndex {
+        public:
+#if H5_VERSION_GE(1, 12, 0)
+        using object_info_t = H5O_info2_t;
+        using token_t       = H5O_token_t;
+#else
+        using object_info_t = H5O_info_t;
+        using token_t       = haddr_t;
+#endif
+        struct Object {
+            H5O_type_t type;
+            token_t    token;
+        };
+
+        private:
+        std::map<std::string, Object, std::less<>> objects; // Keyed by path without the leading "/": the objects below a group are adjacent
+        static herr_t                               visit(hid_t obj, const char *name, const object_info_t *info, void *data);
+
+        public:
+        LinkIndex() = default;
+        explicit LinkIndex(const h5pp::File &h5_src);
+        [[nodiscard]] const Object *find(std::string_view path) const; /*!< nullptr if there is no object at path */
+        [[nodiscard]] bool          exists(std::string_view path) const;
+        [[nodiscard]] bool          is_group(std::string_view path) const;
+        [[nodiscard]] bool          is_dataset(std::string_view path) const;
+        /*! Like h5pp::File::findGroups: paths relative to root, of groups whose relative path contains key, at most depth levels below root */
+        [[nodiscard]] std::vector<std::string> find_groups(std::string_view key, std::string_view root, long hits = -1, long depth = 0) const;
+        /*! FNV-1a over the paths that the key discovery in merge looks at: the algo, state and point groups, and the objects of keys in them.
+         *  Other objects, like the checkpoint/iter_* groups that grow with every iteration of a simulation, do not change the MergePlan. */
+        [[nodiscard]] uint64_t                 get_signature(const tools::h5db::Keys &keys) const;
+        [[nodiscard]] size_t                   size() const { return objects.size(); }
+    };
+
     template<typename T>
     std::string get_standardized_base(const ModelId<T> &H, int decimals = 4);
 
-    std::vector<std::string> findKeys(const h5pp::File &h5_src, const std::string &root, const std::vector<std::string> &expectedKeys, long hits = -1,
+    std::vector<std::string> findKeys(const LinkIndex &srcIndex, const std::string &root, const std::vector<std::string> &expectedKeys, long hits = -1,
                                       long depth = 0);
 
     template<typename T>
-    std::vector<ModelKey> loadModel(const h5pp::File &h5_src, std::unordered_map<std::string, ModelId<T>> &srcModelDb, const std::vector<ModelKey> &srcKeys);
+    std::vector<ModelKey> loadModel(const h5pp::File &h5_src, const LinkIndex &srcIndex, std::unordered_map<std::string, ModelId<T>> &srcModelDb,
+                                    const std::vector<ModelKey> &srcKeys);
 
     template<typename T>
     void saveModel(const h5pp::File &h5_src, h5pp::File &h5_tgt, std::unordered_map<std::string, InfoId<h5pp::TableInfo>> &tgtTableDb,
                    const ModelId<T> &modelId, const FileId &fileId);
 
-    std::vector<DsetKey>  gatherDsetKeys(const h5pp::File &h5_src, std::unordered_map<std::string, h5pp::DsetInfo> &srcDsetDb, const PathId &pathid,
-                                         const std::vector<DsetKey> &srcKeys);
-    std::vector<TableKey> gatherTableKeys(const h5pp::File &h5_src, std::unordered_map<std::string, h5pp::TableInfo> &srcTableDb, const PathId &pathid,
-                                          const std::vector<TableKey> &tables);
-    std::vector<CronoKey> gatherCronoKeys(const h5pp::File &h5_src, std::unordered_map<std::string, h5pp::TableInfo> &srcTableDb, const PathId &pathid,
-                                          const std::vector<CronoKey> &cronos);
-    std::vector<ScaleKey> gatherCronoKeys(const h5pp::File &h5_src, std::unordered_map<std::string, h5pp::TableInfo> &srcTableDb, const PathId &pathid,
-                                          const std::vector<ScaleKey> &cronos);
+    std::vector<DsetKey>  gatherDsetKeys(const h5pp::File &h5_src, const LinkIndex &srcIndex, std::unordered_map<std::string, h5pp::DsetInfo> &srcDsetDb,
+                                         const PathId &pathid, const std::vector<DsetKey> &srcKeys);
+    std::vector<TableKey> gatherTableKeys(const h5pp::File &h5_src, const LinkIndex &srcIndex, std::unordered_map<std::string, h5pp::TableInfo> &srcTableDb,
+                                          const PathId &pathid, const std::vector<TableKey> &tables);
+    std::vector<CronoKey> gatherCronoKeys(const h5pp::File &h5_src, const LinkIndex &srcIndex, std::unordered_map<std::string, h5pp::TableInfo> &srcTableDb,
+                                          const PathId &pathid, const std::vector<CronoKey> &cronos);
+    std::vector<ScaleKey> gatherScaleKeys(const h5pp::File &h5_src, const LinkIndex &srcIndex, std::unordered_map<std::string, h5pp::TableInfo> &srcTableDb,
+                                          const PathId &pathid, const std::vector<ScaleKey> &scales);
 
     void transferDatasets(h5pp::File &h5_tgt, std::unordered_map<std::string, InfoId<h5pp::DsetInfo>> &tgtDsetDb, const h5pp::File &h5_src,
                           std::unordered_map<std::string, h5pp::DsetInfo> &srcDsetDb, const PathId &pathid, const std::vector<DsetKey> &srcDsetKeys,
                           const FileId &fileId);
 
     void transferTables(h5pp::File &h5_tgt, std::unordered_map<std::string, InfoId<h5pp::TableInfo>> &tgtTableDb,
-                        std::unordered_map<std::string, h5pp::TableInfo> &srcTableDb, const PathId &pathid, const std::vector<std::string> &srcTableKeys,
+                        std::unordered_map<std::string, h5pp::TableInfo> &srcTableDb, const PathId &pathid, const std::vector<TableKey> &srcTableKeys,
                         const FileId &fileId);
 
-    void transferCronos(h5pp::File &h5_tgt, std::unordered_map<std::string, InfoId<h5pp::TableInfo>> &tgtTableDb,
-                        std::unordered_map<std::string, h5pp::TableInfo> &srcTableDb, const PathId &pathid, const std::vector<std::string> &srcCronoKeys,
-                        const FileId &fileId, const FileStats &stats);
-    void transferScales(h5pp::File &h5_tgt, std::unordered_map<std::string, InfoId<h5pp::TableInfo>> &tgtTableDb,
-                        std::unordered_map<std::string, h5pp::TableInfo> &srcTableDb, const PathId &pathid, const std::vector<std::string> &srcScaleKeys,
-                        const FileId &fileId, const FileStats &stats);
+    /*! \brief Appends the records of each source crono table to the target table of its iteration, PathId::crono_path
+     *
+     * tgtProgressDb remembers how many records of each source table are merged already, so only the new records of a running simulation are read.
+     */
+    void transferCronos(h5pp::File &h5_tgt, std::unordered_map<std::string, InfoId<BufferedTableInfo>> &tgtTableDb,
+                        std::unordered_map<std::string, ProgressId> &tgtProgressDb, std::unordered_map<std::string, h5pp::TableInfo> &srcTableDb,
+                        const PathId &pathid, const std::vector<CronoKey> &srcCronoKeys, const FileId &fileId, const FileStats &fileStats);
+    /*! \brief Like transferCronos, but the records of each source table go into the column of the seed in one dataset of PathId::crono2d_path
+     *
+     * The time series of consecutive iterations are written with one hyperslab each, usually one per table.
+     * The chunks span many iterations but few seeds, so the few chunks that a seed writes into are completed by the next few seeds.
+     */
+    void transferCronos2d(h5pp::File &h5_tgt, std::unordered_map<std::string, InfoId<h5pp::DsetInfo>> &tgtDsetDb,
+                          std::unordered_map<std::string, ProgressId> &tgtProgressDb, std::unordered_map<std::string, h5pp::TableInfo> &srcTableDb,
+                          const PathId &pathid, const std::vector<CronoKey> &srcCronoKeys, const FileId &fileId, const FileStats &fileStats);
+    void transferScales(h5pp::File &h5_tgt, std::unordered_map<std::string, InfoId<BufferedTableInfo>> &tgtTableDb,
+                        std::unordered_map<std::string, h5pp::TableInfo> &srcTableDb, const PathId &pathid, const std::vector<ScaleKey> &srcScaleKeys,
+                        const FileId &fileId, const FileStats &fileStats);
 
     template<typename ModelType>
-    void merge(h5pp::File &h5_tgt, const h5pp::File &h5_src, const FileId &fileId, const FileStats &fileStats, const tools::h5db::Keys &keys,
-               tools::h5db::TgtDb &tgtdb);
+    void merge(h5pp::File &h5_tgt, const h5pp::File &h5_src, const LinkIndex &srcIndex, const FileId &fileId, const FileStats &fileStats,
+               const tools::h5db::Keys &keys, tools::h5db::TgtDb &tgtdb);
+
+    void mergePartial(h5pp::File &h5_tgt, tools::h5db::TgtDb &tgtdb, const h5pp::File &h5_part, tools::h5db::TgtDb &partdb, const tools::h5db::Keys &keys);
 
     void writeProfiling(h5pp::File &h5_tgt);
 
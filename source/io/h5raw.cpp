@@ -0,0 +1,132 @@
+#include "h5raw.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <io/h5vfd.h>
+#include <io/logger.h>
+#include <numeric>
+#include <sys/uio.h>
+#include <tid/tid.h>
+
+namespace tools::h5raw {
+    namespace internal {
+        bool is_fixed_size(hid_t type) {
+            // Variable-length data and references are stored elsewhere in the file, and need HDF5 to resolve
+            if(H5Tdetect_class(type, H5T_VLEN) != 0) return false;
+            if(H5Tdetect_class(type, H5T_REFERENCE) != 0) return false;
+            if(H5Tget_class(type) == H5T_STRING and H5Tis_variable_str(type) != 0) return false;
+            return true;
+        }
+
+        struct Source {
+            int         fd  = -1;      // sec2
+            const char *mem = nullptr; // core or mmap
+        };
+
+        std::optional<Source> get_source(hid_t file) {
+            // Read through the handle of the driver that HDF5 already uses, so that in-memory files are not read from disk again
+            hid_t fapl = H5Fget_access_plist(file);
+            if(fapl < 0) return std::nullopt;
+            hid_t                 driver = H5Pget_driver(fapl);
+            void                 *handle = nullptr;
+            std::optional<Source> source;
+            if(H5Fget_vfd_handle(file, fapl, &handle) >= 0 and handle != nullptr) {
+                if(driver == H5FD_SEC2)
+                    source = Source{*static_cast<int *>(handle), nullptr};
+                else if(driver == H5FD_CORE or driver == tools::h5vfd::get_image_driver() or driver == tools::h5vfd::get_mmap_driver())
+                    source = Source{-1, *static_cast<const char **>(handle)};
+            }
+            H5Pclose(fapl);
+            if(source and source->fd < 0 and source->mem == nullptr) return std::nullopt;
+            return source;
+        }
+
+        bool read_run(int fd, const std::vector<Extent> &run, std::unordered_map<std::string, std::vector<std::byte>> &result,
+                      std::vector<std::byte> &scratch) {
+            // One preadv for a run of sorted, nearby extents. The gaps between them are read into scratch
+            auto gap_before = [&run](size_t i) { return i == 0 ? size_t{0} : static_cast<size_t>(run[i].offset - (run[i - 1].offset + run[i - 1].bytes)); };
+            // Size scratch for the largest gap before taking pointers into it: resizing later would leave the earlier iovecs dangling
+            size_t maxGap = 0;
+            for(size_t i = 0; i < run.size(); i++) maxGap = std::max(maxGap, gap_before(i));
+            if(scratch.size() < maxGap) scratch.resize(maxGap);
+            std::vector<iovec> iov;
+            iov.reserve(2 * run.size());
+            size_t total = 0;
+            for(size_t i = 0; i < run.size(); i++) {
+                if(auto gap = gap_before(i); gap > 0) {
+                    iov.push_back({scratch.data(), gap});
+                    total += gap;
+                }
+                auto &data = result[run[i].key];
+                data.resize(run[i].bytes);
+                iov.push_back({data.data(), data.size()});
+                total += data.size();
+            }
+            ssize_t num = 0;
+            while((num = ::preadv(fd, iov.data(), static_cast<int>(iov.size()), static_cast<off_t>(run.front().offset))) < 0 and errno == EINTR) {}
+            if(num == static_cast<ssize_t>(total)) return true;
+            for(const auto &e : run) result.erase(e.key); // Short read, e.g. a truncated file: let HDF5 handle these
+            return false;
+        }
+    }
+
+    std::optional<Extent> get_extent(const h5pp::DsetInfo &info) {
+        if(not info.h5Dset or not info.h5Type or not info.dsetSize or info.h5Layout != H5D_CONTIGUOUS) return std::nullopt;
+        if(not internal::is_fixed_size(info.h5Type.value())) return std::nullopt;
+        auto offset = H5Dget_offset(info.h5Dset.value());
+        if(offset == HADDR_UNDEF) return std::nullopt; // Not allocated yet, or stored in external files
+        auto bytes = static_cast<size_t>(H5Dget_storage_size(info.h5Dset.value()));
+        if(bytes == 0 or bytes != info.dsetSize.value() * H5Tget_size(info.h5Type.value())) return std::nullopt;
+        return Extent{info.dsetPath.value_or(""), offset, bytes};
+    }
+
+    std::unordered_map<std::string, std::vector<std::byte>> read_dsets(hid_t file, const std::unordered_map<std::string, h5pp::DsetInfo> &db,
+                                                                       const std::vector<std::string> &keys) {
+        std::unordered_map<std::string, std::vector<std::byte>> result;
+        std::vector<Extent>                                     extents;
+        for(const auto &key : keys) {
+            auto info = db.find(key);
+            if(info == db.end() or not info->second.dsetExists.value_or(false)) continue;
+            if(auto extent = get_extent(info->second)) {
+                extent->key = key;
+                extents.emplace_back(extent.value());
+            }
+        }
+        if(extents.empty()) return result;
+        auto source = internal::get_source(file);
+        if(not source) return result;
+        auto t_scope = tid::tic_scope(__FUNCTION__);
+        std::sort(extents.begin(), extents.end(), [](const Extent &a, const Extent &b) { return a.offset < b.offset; });
+
+        if(source->mem != nullptr) {
+            // The image or mapping ends at the end of the file. Extents past it, e.g. in a truncated file, are left to HDF5
+            hsize_t eof = 0;
+            if(H5Fget_filesize(file, &eof) < 0) return result;
+            for(const auto &e : extents) {
+                if(e.offset + e.bytes > eof) continue;
+                auto &data = result[e.key];
+                data.resize(e.bytes);
+                if(not tools::h5vfd::copy_mapped(data.data(), source->mem + e.offset, e.bytes)) result.erase(e.key);
+            }
+            return result;
+        }
+
+        // Extents that are close enough are read in one call, skipping over the bytes in between
+        constexpr haddr_t      maxGap  = 4096;
+        constexpr size_t       maxIov  = std::min(IOV_MAX, 1024) / 2;
+        std::vector<std::byte> scratch;
+        std::vector<Extent>    run;
+        for(const auto &e : extents) {
+            bool overlaps = not run.empty() and e.offset < run.back().offset + run.back().bytes; // E.g. two keys for the same dataset
+            bool too_far  = not run.empty() and e.offset > run.back().offset + run.back().bytes + maxGap;
+            if(overlaps or too_far or run.size() >= maxIov) {
+                internal::read_run(source->fd, run, result, scratch);
+                run.clear();
+            }
+            run.emplace_back(e);
+        }
+        internal::read_run(source->fd, run, result, scratch);
+        return result;
+    }
+}
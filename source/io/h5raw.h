@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <h5pp/details/h5ppInfo.h>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace tools::h5raw {
+    /*! \brief The bytes of a dataset as they are stored in its file */
+    struct Extent {
+        std::string key;
+        haddr_t     offset = HADDR_UNDEF;
+        size_t      bytes  = 0;
+    };
+
+    /*! \brief The byte range of a dataset, if it can be read without HDF5
+     *
+     * That is the case when the dataset is contiguous (so it cannot be filtered), allocated in the file itself,
+     * and of a fixed-size type whose storage size matches its dimensions. Then the bytes on file are exactly what H5Dread gives
+     * with the file type as memory type. Otherwise nullopt, and the dataset should be read with HDF5.
+     */
+    [[nodiscard]] std::optional<Extent> get_extent(const h5pp::DsetInfo &info);
+
+    /*! \brief Reads the datasets keys in db that get_extent accepts, bypassing HDF5, with as few reads as possible
+     *
+     * The byte ranges are resolved with H5Dget_offset on the open datasets, sorted, and read through the file driver:
+     * with preadv for sec2, where nearby ranges are merged into one call, or with memcpy for in-memory and mmap files.
+     * Datasets that are missing from the result, e.g. because they are chunked or the read failed, should be read with HDF5.
+     *
+     * Only transferDatasets reads this way. Tables, cronos and scales are appended to while a simulation runs, so HDF5 has to store them
+     * chunked, and get_extent would decline every one of them. Reading their chunks raw would mean decoding the chunk index and filters.
+     */
+    [[nodiscard]] std::unordered_map<std::string, std::vector<std::byte>> read_dsets(hid_t file, const std::unordered_map<std::string, h5pp::DsetInfo> &db,
+                                                                                   const std::vector<std::string> &keys);
+}
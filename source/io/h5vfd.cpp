@@ -0,0 +1,277 @@
+#include "h5vfd.h"
+#include <algorithm>
+#include <cerrno>
+#include <csetjmp>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <io/logger.h>
+#include <limits>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#if H5_VERSION_GE(1, 13, 2)
+    #include <H5FDdevelop.h>
+#endif
+
+namespace tools::h5vfd {
+    namespace internal {
+        thread_local sigjmp_buf *copy_jmp = nullptr; // Set while copy_mapped copies on this thread
+        struct sigaction         old_sigbus {};
+
+        void on_sigbus(int sig, siginfo_t *info, void *context) {
+            if(copy_jmp != nullptr) siglongjmp(*copy_jmp, 1);
+            // Not a fault in copy_mapped: pass it on to the previous handler, but stay installed for the copies that follow
+            if((old_sigbus.sa_flags & SA_SIGINFO) != 0) {
+                if(old_sigbus.sa_sigaction != nullptr) old_sigbus.sa_sigaction(sig, info, context);
+            } else if(old_sigbus.sa_handler == SIG_DFL) {
+                // The default action ends the process, so there are no later copies to protect. It takes the signal when the handler returns
+                struct sigaction dfl {};
+                dfl.sa_handler = SIG_DFL;
+                sigemptyset(&dfl.sa_mask);
+                sigaction(SIGBUS, &dfl, nullptr);
+                raise(sig);
+            } else if(old_sigbus.sa_handler != SIG_IGN) {
+                old_sigbus.sa_handler(sig);
+            }
+        }
+
+        struct mem_file {
+            H5FD_t  pub; // Must come first: HDF5 fills it in and casts between the two
+            void   *map = nullptr; // The contents of the file: a file image or a mapping
+            haddr_t eof = 0;
+            haddr_t eoa = 0;
+            dev_t   dev = 0;
+            ino_t   ino = 0;
+        };
+
+        struct image_fapl {
+            const void *data = nullptr;
+            size_t      size = 0;
+        };
+
+        struct mmap_fapl {
+            const char *path = nullptr; // Map this file instead of the one named in H5Fopen
+        };
+
+        template<typename Fapl>
+        void *fapl_copy(const void *fapl) {
+            return new Fapl(*static_cast<const Fapl *>(fapl));
+        }
+        template<typename Fapl>
+        herr_t fapl_free(void *fapl) {
+            delete static_cast<Fapl *>(fapl);
+            return 0;
+        }
+
+        H5FD_t *image_open(const char *name, unsigned flags, hid_t fapl, haddr_t maxaddr) {
+            if((flags & (H5F_ACC_RDWR | H5F_ACC_CREAT | H5F_ACC_TRUNC | H5F_ACC_EXCL)) != 0) {
+                tools::logger::log->error("image driver: {} can only be opened read-only", name);
+                return nullptr;
+            }
+            const auto *fa = static_cast<const image_fapl *>(H5Pget_driver_info(fapl));
+            if(fa == nullptr or fa->data == nullptr or static_cast<haddr_t>(fa->size) > maxaddr) return nullptr;
+            auto *file = new mem_file();
+            file->map  = const_cast<void *>(fa->data); // Never written to: the driver is read-only
+            file->eof  = static_cast<haddr_t>(fa->size);
+            struct stat st {};
+            if(::stat(name, &st) == 0) { // Only used to tell files apart in mem_cmp
+                file->dev = st.st_dev;
+                file->ino = st.st_ino;
+            }
+            return &file->pub;
+        }
+
+        herr_t image_close(H5FD_t *_file) {
+            delete reinterpret_cast<mem_file *>(_file); // The image belongs to the caller
+            return 0;
+        }
+
+        H5FD_t *mmap_open(const char *name, unsigned flags, hid_t fapl, haddr_t maxaddr) {
+            if((flags & (H5F_ACC_RDWR | H5F_ACC_CREAT | H5F_ACC_TRUNC | H5F_ACC_EXCL)) != 0) {
+                tools::logger::log->error("mmap driver: {} can only be opened read-only", name);
+                return nullptr;
+            }
+            const auto *fa = static_cast<const mmap_fapl *>(H5Pget_driver_info(fapl));
+            if(fa != nullptr and fa->path != nullptr) name = fa->path;
+            int fd = ::open(name, O_RDONLY | O_CLOEXEC);
+            if(fd < 0) return nullptr;
+            struct stat st {};
+            if(::fstat(fd, &st) < 0 or static_cast<haddr_t>(st.st_size) > maxaddr) {
+                ::close(fd);
+                return nullptr;
+            }
+            auto *file = new mem_file();
+            file->eof  = static_cast<haddr_t>(st.st_size);
+            file->dev  = st.st_dev;
+            file->ino  = st.st_ino;
+            if(st.st_size > 0) {
+                file->map = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                if(file->map == MAP_FAILED) {
+                    tools::logger::log->debug("mmap driver: could not map {}: {}", name, std::strerror(errno));
+                    ::close(fd);
+                    delete file;
+                    return nullptr;
+                }
+                // Metadata is scattered, but the files are small: have the kernel read all of it ahead
+                ::madvise(file->map, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+                ::madvise(file->map, static_cast<size_t>(st.st_size), MADV_WILLNEED);
+            }
+            ::close(fd); // The mapping keeps the file alive
+            return &file->pub;
+        }
+
+        herr_t mmap_close(H5FD_t *_file) {
+            auto *file = reinterpret_cast<mem_file *>(_file);
+            if(file->map != nullptr) ::munmap(file->map, file->eof);
+            delete file;
+            return 0;
+        }
+
+        int mem_cmp(const H5FD_t *_f1, const H5FD_t *_f2) {
+            const auto *f1 = reinterpret_cast<const mem_file *>(_f1);
+            const auto *f2 = reinterpret_cast<const mem_file *>(_f2);
+            if(f1->dev != f2->dev) return f1->dev < f2->dev ? -1 : 1;
+            if(f1->ino != f2->ino) return f1->ino < f2->ino ? -1 : 1;
+            return 0;
+        }
+
+        herr_t mem_query(const H5FD_t * /* file */, unsigned long *flags) {
+            // No metadata accumulator or data sieve buffer: they would only add another copy of what is already in memory
+            if(flags != nullptr) *flags = 0;
+            return 0;
+        }
+
+        haddr_t mem_get_eoa(const H5FD_t *_file, H5FD_mem_t /* type */) { return reinterpret_cast<const mem_file *>(_file)->eoa; }
+
+        herr_t mem_set_eoa(H5FD_t *_file, H5FD_mem_t /* type */, haddr_t addr) {
+            reinterpret_cast<mem_file *>(_file)->eoa = addr;
+            return 0;
+        }
+
+        haddr_t mem_get_eof(const H5FD_t *_file, H5FD_mem_t /* type */) { return reinterpret_cast<const mem_file *>(_file)->eof; }
+
+        herr_t mem_get_handle(H5FD_t *_file, hid_t /* fapl */, void **file_handle) {
+            if(file_handle == nullptr) return -1;
+            *file_handle = &reinterpret_cast<mem_file *>(_file)->map;
+            return 0;
+        }
+
+        herr_t mem_read(H5FD_t *_file, H5FD_mem_t /* type */, hid_t /* dxpl */, haddr_t addr, size_t size, void *buf) {
+            const auto *file = reinterpret_cast<const mem_file *>(_file);
+            if(addr == HADDR_UNDEF or addr + size < addr or addr + size > file->eoa) return -1;
+            // Like sec2, reading past the end of the file gives zeros
+            size_t num = addr < file->eof ? static_cast<size_t>(std::min<haddr_t>(size, file->eof - addr)) : 0;
+            if(num > 0 and not copy_mapped(buf, static_cast<const char *>(file->map) + addr, num)) {
+                tools::logger::log->warn("mmap driver: the file shrank while it was mapped");
+                return -1;
+            }
+            if(num < size) std::memset(static_cast<char *>(buf) + num, 0, size - num);
+            return 0;
+        }
+
+        herr_t mem_write(H5FD_t * /* file */, H5FD_mem_t /* type */, hid_t /* dxpl */, haddr_t /* addr */, size_t /* size */, const void * /* buf */) {
+            return -1; // Read-only
+        }
+
+        H5FD_class_t make_image_class() {
+            H5FD_class_t cls{};
+#if H5_VERSION_GE(1, 13, 2)
+            cls.version = H5FD_CLASS_VERSION;
+            cls.value   = static_cast<H5FD_class_value_t>(612); // Unregistered value, above the range reserved by the HDF Group
+#endif
+            cls.name       = "h5mbl_image";
+            cls.maxaddr    = static_cast<haddr_t>(std::numeric_limits<off_t>::max());
+            cls.fc_degree  = H5F_CLOSE_WEAK;
+            cls.fapl_size  = sizeof(image_fapl);
+            cls.fapl_copy  = fapl_copy<image_fapl>;
+            cls.fapl_free  = fapl_free<image_fapl>;
+            cls.open       = image_open;
+            cls.close      = image_close;
+            cls.cmp        = mem_cmp;
+            cls.query      = mem_query;
+            cls.get_eoa    = mem_get_eoa;
+            cls.set_eoa    = mem_set_eoa;
+            cls.get_eof    = mem_get_eof;
+            cls.get_handle = mem_get_handle;
+            cls.read       = mem_read;
+            cls.write      = mem_write;
+            return cls;
+        }
+
+        H5FD_class_t make_mmap_class() {
+            auto cls = make_image_class(); // Reads are served from memory the same way: only opening and closing differ
+#if H5_VERSION_GE(1, 13, 2)
+            cls.value = static_cast<H5FD_class_value_t>(611);
+#endif
+            cls.name      = "h5mbl_mmap";
+            cls.fapl_size = sizeof(mmap_fapl);
+            cls.fapl_copy = fapl_copy<mmap_fapl>;
+            cls.fapl_free = fapl_free<mmap_fapl>;
+            cls.open      = mmap_open;
+            cls.close     = mmap_close;
+            return cls;
+        }
+
+        hid_t get_driver(const H5FD_class_t &cls, hid_t &driver_id) {
+            // HDF5 drops the registration when the library is closed, so check that it is still valid
+            if(driver_id < 0 or H5Iis_valid(driver_id) <= 0) driver_id = H5FDregister(&cls);
+            return driver_id;
+        }
+    }
+
+    bool copy_mapped(void *dst, const void *src, size_t size) {
+        static std::once_flag once;
+        std::call_once(once, []() {
+            struct sigaction action {};
+            action.sa_sigaction = internal::on_sigbus;
+            action.sa_flags     = SA_SIGINFO;
+            sigemptyset(&action.sa_mask);
+            sigaction(SIGBUS, &action, &internal::old_sigbus);
+        });
+        sigjmp_buf jmp;
+        if(sigsetjmp(jmp, 1) != 0) {
+            internal::copy_jmp = nullptr;
+            return false;
+        }
+        internal::copy_jmp = &jmp;
+        std::memcpy(dst, src, size);
+        internal::copy_jmp = nullptr;
+        return true;
+    }
+
+    hid_t get_image_driver() {
+        static const H5FD_class_t cls       = internal::make_image_class();
+        static hid_t              driver_id = H5I_INVALID_HID;
+        return internal::get_driver(cls, driver_id);
+    }
+
+    hid_t get_mmap_driver() {
+        static const H5FD_class_t cls       = internal::make_mmap_class();
+        static hid_t              driver_id = H5I_INVALID_HID;
+        return internal::get_driver(cls, driver_id);
+    }
+
+    herr_t set_fapl_mmap(hid_t fapl) {
+        auto driver_id = get_mmap_driver();
+        if(driver_id < 0) return -1;
+        internal::mmap_fapl info{};
+        return H5Pset_driver(fapl, driver_id, &info);
+    }
+
+    herr_t set_fapl_image(hid_t fapl, const void *data, size_t size) {
+        auto driver_id = get_image_driver();
+        if(driver_id < 0 or data == nullptr) return -1;
+        internal::image_fapl info{data, size};
+        return H5Pset_driver(fapl, driver_id, &info); // HDF5 keeps a copy of info, but not of the image
+    }
+
+    herr_t set_fapl_redirect(hid_t fapl, const char *path) {
+        auto driver_id = get_mmap_driver();
+        if(driver_id < 0 or path == nullptr) return -1;
+        internal::mmap_fapl info{path};
+        return H5Pset_driver(fapl, driver_id, &info); // HDF5 keeps a copy of info, but not of the path
+    }
+}
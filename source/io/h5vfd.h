@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <hdf5.h>
+
+namespace tools::h5vfd {
+    /*! \brief Read-only HDF5 file driver that serves a file image already in memory
+     *
+     * H5Pset_file_image on the core driver refuses to open an image under the name of a file that exists on disk,
+     * while h5pp always opens a source file by its own path. This driver reads from the image instead of the file of that name,
+     * without copying it. Opening for writing fails. The driver is registered with HDF5 on first use.
+     */
+    [[nodiscard]] hid_t get_image_driver();
+
+    /*! \brief Read-only HDF5 file driver that maps the whole file with mmap
+     *
+     * The file is mapped with PROT_READ and advised MADV_SEQUENTIAL and MADV_WILLNEED, so the kernel reads it ahead in large chunks.
+     * HDF5 then copies metadata and raw data straight out of the page cache, without a heap copy of the file or a read syscall per access.
+     * Reads are served like those of the image driver, through copy_mapped. Opening for writing fails. The driver is registered with HDF5 on first use.
+     */
+    [[nodiscard]] hid_t get_mmap_driver();
+
+    /*! \brief memcpy out of a file mapping, which returns false instead of raising SIGBUS if the file has shrunk under the mapping
+     *
+     * Touching a mapped page past the end of the file raises SIGBUS, e.g. after a simulation that is still running truncates or recreates it.
+     * Here that becomes a read error, like with sec2, so the file is quarantined instead of the rank being killed.
+     */
+    [[nodiscard]] bool copy_mapped(void *dst, const void *src, size_t size);
+
+    /*! \brief Makes files opened with the file access property list fapl use the mmap driver */
+    herr_t set_fapl_mmap(hid_t fapl);
+
+    /*! \brief Makes files opened with fapl read from the file image in [data, data + size) instead, without copying it
+     *
+     * The buffer must outlive the file.
+     */
+    herr_t set_fapl_image(hid_t fapl, const void *data, size_t size);
+
+    /*! \brief Makes files opened with fapl map the file at path instead, e.g. a local copy of it
+     *
+     * HDF5 and h5pp still see the name passed to H5Fopen, so paths derived from it stay the same. The path must outlive the file.
+     */
+    herr_t set_fapl_redirect(hid_t fapl, const char *path);
+}
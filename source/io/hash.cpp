@@ -77,15 +77,19 @@ namespace tools::hash {
 
     std::string std_hash(const std::string &str) { return std::to_string(std::hash<std::string>{}(str)); }
 
-    std::string hash_file_meta(const h5pp::fs::path &fpath, const std::string &more_meta) {
+    std::string hash_file_meta(const h5pp::fs::path &fpath, h5pp::fs::file_time_type mtime, const std::string &more_meta) {
         auto t_scope = tid::tic_scope(__FUNCTION__);
         std::string meta;
         meta.reserve(512);
         meta += fpath.string() + '\n';
-        meta += std::to_string(h5pp::fs::last_write_time(fpath).time_since_epoch().count()) + '\n';
+        meta += std::to_string(mtime.time_since_epoch().count()) + '\n';
         if(not more_meta.empty()) meta += more_meta + '\n';
         return std_hash(meta);
         //        return md5_string(meta);
     }
 
+    std::string hash_file_meta(const h5pp::fs::path &fpath, const std::string &more_meta) {
+        return hash_file_meta(fpath, h5pp::fs::last_write_time(fpath), more_meta);
+    }
+
 }
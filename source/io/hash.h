@@ -8,6 +8,7 @@ namespace tools::hash {
     std::string    md5_string(const std::string &str);
     std::string    std_hash(const std::string &str);
     std::string    hash_file_meta(const h5pp::fs::path &fpath, const std::string &more_meta = "");
+    std::string    hash_file_meta(const h5pp::fs::path &fpath, h5pp::fs::file_time_type mtime, const std::string &more_meta = "");
     constexpr long hash_length();
 
 }
@@ -1,4 +1,6 @@
 #include "id.h"
+#include <algorithm>
+#include <general/pattern.h>
 #include <h5pp/details/h5ppHdf5.h>
 #include <h5pp/details/h5ppInfo.h>
 #include <tid/tid.h>
@@ -13,15 +15,17 @@ BufferedTableInfo &BufferedTableInfo::operator=(h5pp::TableInfo *info_) {
 }
 BufferedTableInfo::~BufferedTableInfo() { flush(); }
 
-void BufferedTableInfo::insert(const std::vector<std::byte> &entry, hsize_t index) {
+void BufferedTableInfo::insert(const std::vector<std::byte> &entry, hsize_t index) { insert(entry.data(), entry.size(), index); }
+
+void BufferedTableInfo::insert(const std::byte *entry, size_t bytes, hsize_t index) {
     if(info == nullptr) throw std::runtime_error("insert: info is nullptr");
-    if(entry.size() != info->recordBytes.value()) throw std::runtime_error("insert: record and entry size mismatch");
+    if(bytes != info->recordBytes.value()) throw std::runtime_error("insert: record and entry size mismatch");
     if(recordBuffer.size() >= maxRecords) flush();
 
     // We need to find out if there is already a contigous buffer where we can append this entry. If not, we start a new contiguous buffer
     for(auto &r : recordBuffer) {
         if(r.offset + r.extent == index) {
-            r.rawdata.insert(r.rawdata.end(), entry.begin(), entry.end());
+            r.rawdata.insert(r.rawdata.end(), entry, entry + bytes);
             r.extent += 1;
             //            h5pp::print("Inserting 1 records at index {} into offset {} extent {}\n", index, r.offset, r.extent );
 
@@ -29,7 +33,7 @@ void BufferedTableInfo::insert(const std::vector<std::byte> &entry, hsize_t inde
         }
     }
     // None was found, so we make a new one
-    recordBuffer.emplace_back(ContiguousBuffer{index, 1ul, entry});
+    recordBuffer.emplace_back(ContiguousBuffer{index, 1ul, std::vector<std::byte>(entry, entry + bytes)});
     //    auto & r = recordBuffer.back();
     //    h5pp::print("Inserting 1 records at index {} into offset {} extent {}\n",  index, r.offset, r.extent );
 }
@@ -52,6 +56,27 @@ FileId::FileId(long seed_, std::string_view path_, std::string_view hash_) : see
 }
 std::string FileId::string() const { return h5pp::format("path [{}] | seed {} | hash {}", path, seed, hash); }
 
+QuarantineId::QuarantineId(const FileId &fileId, std::string_view reason_) : seed(fileId.seed) {
+    strncpy(path, fileId.path, sizeof(path) - 1);
+    strncpy(hash, fileId.hash, sizeof(hash) - 1);
+    strncpy(reason, reason_.data(), std::min(reason_.size(), sizeof(reason) - 1));
+    path[sizeof(path) - 1]     = '\0';
+    hash[sizeof(hash) - 1]     = '\0';
+    reason[sizeof(reason) - 1] = '\0';
+}
+std::string QuarantineId::string() const { return h5pp::format("path [{}] | seed {} | hash {} | reason {}", path, seed, hash, reason); }
+
+ManifestId::ManifestId(std::string_view path_, long mtime_, size_t count_, long seed_, long newest_)
+    : mtime(mtime_), count(count_), seed(seed_), newest(newest_) {
+    strncpy(path, path_.data(), sizeof(path) - 1);
+    path[sizeof(path) - 1] = '\0';
+}
+bool ManifestId::operator==(const ManifestId &rhs) const {
+    return std::string_view(path) == std::string_view(rhs.path) and mtime == rhs.mtime and count == rhs.count and seed == rhs.seed and
+           newest == rhs.newest;
+}
+std::string ManifestId::string() const { return h5pp::format("path [{}] | mtime {} | count {} | seed {} | newest {}", path, mtime, count, seed, newest); }
+
 template<typename InfoType>
 InfoId<InfoType>::InfoId(long seed_, hsize_t index_) {
     db[seed_] = index_;
@@ -80,13 +105,8 @@ PathId::PathId(std::string_view base_, std::string_view algo_, std::string_view
 }
 
 bool PathId::match(std::string_view comp, std::string_view pattern) {
-    auto t_scope  = tid::tic_scope(__FUNCTION__);
-    auto fuzz_pos = pattern.find_first_of('*', 0);
-    auto has_fuzz = fuzz_pos != std::string_view::npos;
-    if(has_fuzz)
-        return text::startsWith(comp, pattern.substr(0, fuzz_pos));
-    else
-        return comp == pattern;
+    auto t_scope = tid::tic_scope(__FUNCTION__);
+    return text::pattern::cached(pattern, text::pattern::syntax::glob).match(comp);
 }
 
 bool PathId::match(std::string_view algo_pattern, std::string_view state_pattern, std::string_view point_pattern) const {
@@ -105,6 +125,23 @@ bool PathId::match(std::string_view algo_pattern, std::string_view state_pattern
      */
     return h5pp::format("{}/{}/{}/cronos/iter_{}/{}", base, algo, state, iter, tablename);
 }
+[[nodiscard]] std::string PathId::progress_path(std::string_view tablename) const {
+    // The number of records merged from each seed into the cronos of <tablename>. Not a ".db" group: those hold seed/index databases
+    return h5pp::format("{}/{}/{}/cronos/.progress/{}", base, algo, state, tablename);
+}
+[[nodiscard]] std::string PathId::crono2d_path(std::string_view tablename) const {
+    /*
+     * When collecting a "crono" kind of table with tools::h5io::crono2d:
+     *      - the source path is <base>/<algo>/<state>/tables/<tablename>
+     *      - the target path <base>/<algo>/<state>/crono2d/<tablename> is a single dataset of records with dimensions [iteration x seed]
+     *      - row <iter> holds the records with that iteration number, and each realization has a column, as listed in the seed database
+     *      - a time series or an iteration over all realizations is then one hyperslab: a column or a row
+     */
+    return h5pp::format("{}/{}/{}/crono2d/{}", base, algo, state, tablename);
+}
+[[nodiscard]] std::string PathId::crono2d_progress_path(std::string_view tablename) const {
+    return h5pp::format("{}/{}/{}/crono2d/.progress/{}", base, algo, state, tablename);
+}
 [[nodiscard]] std::string PathId::scale_path(std::string_view tablename, size_t chi) const {
     /*
      * When collecting a "scale" kind of table:
@@ -133,6 +170,38 @@ void H5T_FileId::register_table_type() {
     H5Tinsert(h5_type, "hash", HOFFSET(FileId, hash), H5T_HASH);
 }
 
+H5T_ManifestId::H5T_ManifestId() { register_table_type(); }
+void H5T_ManifestId::register_table_type() {
+    if(h5_type.valid()) return;
+    auto           t_scope  = tid::tic_scope(__FUNCTION__);
+    h5pp::hid::h5t H5T_PATH = H5Tcopy(H5T_C_S1);
+    H5Tset_size(H5T_PATH, 256);
+    h5_type = H5Tcreate(H5T_COMPOUND, sizeof(ManifestId));
+    H5Tinsert(h5_type, "path", HOFFSET(ManifestId, path), H5T_PATH);
+    H5Tinsert(h5_type, "mtime", HOFFSET(ManifestId, mtime), H5T_NATIVE_LONG);
+    H5Tinsert(h5_type, "count", HOFFSET(ManifestId, count), H5T_NATIVE_UINT64);
+    H5Tinsert(h5_type, "seed", HOFFSET(ManifestId, seed), H5T_NATIVE_LONG);
+    H5Tinsert(h5_type, "newest", HOFFSET(ManifestId, newest), H5T_NATIVE_LONG);
+}
+
+H5T_QuarantineId::H5T_QuarantineId() { register_table_type(); }
+void H5T_QuarantineId::register_table_type() {
+    if(h5_type.valid()) return;
+    auto           t_scope    = tid::tic_scope(__FUNCTION__);
+    h5pp::hid::h5t H5T_HASH   = H5Tcopy(H5T_C_S1);
+    h5pp::hid::h5t H5T_PATH   = H5Tcopy(H5T_C_S1);
+    h5pp::hid::h5t H5T_REASON = H5Tcopy(H5T_C_S1);
+    H5Tset_size(H5T_PATH, 256);
+    H5Tset_size(H5T_HASH, 32);
+    H5Tset_size(H5T_REASON, 256);
+    H5Tset_strpad(H5T_HASH, H5T_STR_NULLTERM);
+    h5_type = H5Tcreate(H5T_COMPOUND, sizeof(QuarantineId));
+    H5Tinsert(h5_type, "seed", HOFFSET(QuarantineId, seed), H5T_NATIVE_LONG);
+    H5Tinsert(h5_type, "path", HOFFSET(QuarantineId, path), H5T_PATH);
+    H5Tinsert(h5_type, "hash", HOFFSET(QuarantineId, hash), H5T_HASH);
+    H5Tinsert(h5_type, "reason", HOFFSET(QuarantineId, reason), H5T_REASON);
+}
+
 H5T_SeedId::H5T_SeedId() { register_table_type(); }
 void H5T_SeedId::register_table_type() {
     auto t_scope = tid::tic_scope(__FUNCTION__);
@@ -29,6 +29,7 @@ struct BufferedTableInfo {
     ~BufferedTableInfo();
 
     void insert(const std::vector<std::byte> &entry, hsize_t index /* In units of table entries */);
+    void insert(const std::byte *entry, size_t bytes, hsize_t index /* In units of table entries */);
     void flush();
 };
 
@@ -54,6 +55,28 @@ struct FileId {
     [[nodiscard]] std::string string() const;
 };
 
+struct QuarantineId {
+    long seed        = -1;
+    char path[256]   = {};
+    char hash[32]    = {}; // The hash of the file when it failed. The file is retried when it changes
+    char reason[256] = {};
+    QuarantineId()   = default;
+    QuarantineId(const FileId &fileId, std::string_view reason_);
+    [[nodiscard]] std::string string() const;
+};
+
+struct ManifestId {
+    char   path[256] = {};
+    long   mtime     = 0; // Last write time of the directory
+    size_t count     = 0; // Number of .h5 files in the directory
+    long   seed      = -1; // Highest seed in the directory
+    long   newest    = 0; // Last write time of the newest .h5 file, which changes when a running simulation appends to its file
+    ManifestId()     = default;
+    ManifestId(std::string_view path_, long mtime_, size_t count_, long seed_, long newest_);
+    [[nodiscard]] bool        operator==(const ManifestId &rhs) const;
+    [[nodiscard]] std::string string() const;
+};
+
 struct lbit {
     double                   J1_mean, J2_mean, J3_mean;
     double                   J1_wdth, J2_wdth, J3_wdth;
@@ -95,6 +118,9 @@ struct PathId {
     [[nodiscard]] std::string dset_path(std::string_view dsetname) const;
     [[nodiscard]] std::string table_path(std::string_view tablename) const;
     [[nodiscard]] std::string crono_path(std::string_view tablename, size_t iter) const;
+    [[nodiscard]] std::string progress_path(std::string_view tablename) const;
+    [[nodiscard]] std::string crono2d_path(std::string_view tablename) const;
+    [[nodiscard]] std::string crono2d_progress_path(std::string_view tablename) const;
     [[nodiscard]] std::string scale_path(std::string_view tablename, size_t chi) const;
 
     private:
@@ -166,6 +192,35 @@ struct SeedId {
     [[nodiscard]] std::string string() const { return h5pp::format("seed {} | index {}", index, seed); }
 };
 
+/*! \brief The number of records already merged from a crono source table, per seed
+ *
+ * Running simulations keep appending records to their tables. When such a source file is merged again, only the records past
+ * this count are new, so only those are read and appended to the cronos. It is saved as a table of SeedId, with the count as index.
+ */
+struct ProgressId {
+    private:
+    bool                              modified = false;
+    std::unordered_map<long, hsize_t> db;
+
+    public:
+    ProgressId() = default;
+    ProgressId(const std::vector<SeedId> &seedIds) { // As loaded from file: not modified
+        for(const auto &seedId : seedIds) db[seedId.seed] = seedId.index;
+    }
+    bool    db_modified() const { return modified; }
+    hsize_t get_count(long seed) const {
+        auto res = db.find(seed);
+        return res != db.end() ? res->second : 0;
+    }
+    void set_count(long seed, hsize_t count) {
+        auto res = db.insert({seed, count});
+        if(not res.second and res.first->second == count) return;
+        res.first->second = count;
+        modified          = true;
+    }
+    [[nodiscard]] const std::unordered_map<long, hsize_t> &get_db() const { return db; }
+};
+
 class H5T_FileId {
     public:
     static inline h5pp::hid::h5t h5_type;
@@ -173,6 +228,20 @@ class H5T_FileId {
     static void register_table_type();
 };
 
+class H5T_ManifestId {
+    public:
+    static inline h5pp::hid::h5t h5_type;
+    H5T_ManifestId();
+    static void register_table_type();
+};
+
+class H5T_QuarantineId {
+    public:
+    static inline h5pp::hid::h5t h5_type;
+    H5T_QuarantineId();
+    static void register_table_type();
+};
+
 class H5T_SeedId {
     public:
     static inline h5pp::hid::h5t h5_type;
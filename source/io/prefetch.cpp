@@ -0,0 +1,286 @@
+#include "prefetch.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <fcntl.h>
+#include <io/logger.h>
+#include <limits>
+#include <sys/sysinfo.h>
+#include <tid/tid.h>
+#include <unistd.h>
+
+namespace tools::io {
+    bool read_file(const h5pp::fs::path &path, std::vector<std::byte> &data, uintmax_t size) {
+        // One large sequential read. The file may have changed size since it was listed, so read until EOF
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if(fd < 0) return false;
+        data.resize(size);
+        size_t offset = 0;
+        while(true) {
+            if(offset == data.size()) data.resize(data.size() + 64 * 1024);
+            auto num = ::pread(fd, data.data() + offset, data.size() - offset, static_cast<off_t>(offset));
+            if(num < 0 and errno == EINTR) continue;
+            if(num < 0) {
+                ::close(fd);
+                return false;
+            }
+            if(num == 0) break;
+            offset += static_cast<size_t>(num);
+        }
+        ::close(fd);
+        data.resize(offset);
+        return true;
+    }
+
+    prefetcher::prefetcher(std::vector<FileEntry> files_, size_t max_files_, uintmax_t max_bytes_, concurrency *control_)
+        : files(std::move(files_)), max_files(std::max<size_t>(max_files_, 1)), max_bytes(max_bytes_), control(control_) {
+        // One thread per read that the controller may allow. Most of them sleep while the filesystem is slow
+        auto num_workers = std::min(control ? control->get_max_limit() : size_t{1}, std::max<size_t>(files.size(), 1));
+        for(size_t i = 0; i < num_workers; i++) workers.emplace_back(&prefetcher::run, this);
+    }
+
+    prefetcher::~prefetcher() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        cv.notify_all();
+        for(auto &worker : workers)
+            if(worker.joinable()) worker.join();
+    }
+
+    void prefetcher::run() {
+        while(true) {
+            size_t index;
+            {
+                // Wait for a free slot and room. An oversized file is let through once nothing else is ahead of the caller
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&] {
+                    if(stop or num_claimed >= files.size()) return true;
+                    auto limit = control ? std::max<size_t>(control->get_limit(), 1) : 1;
+                    if(num_reading >= limit) return false;
+                    if(num_claimed == num_taken) return true;
+                    return num_claimed - num_taken < max_files and pending_bytes + files[num_claimed].size <= max_bytes;
+                });
+                if(stop or num_claimed >= files.size()) return;
+                index = num_claimed++;
+                num_reading++;
+                pending_bytes += files[index].size;
+            }
+            Item item{files[index], {}, false};
+            auto t_read = std::chrono::steady_clock::now();
+            item.ok     = read_file(item.src.path, item.data, item.src.size);
+            if(control and item.ok)
+                control->report(concurrency::op::read, std::chrono::duration<double>(std::chrono::steady_clock::now() - t_read).count(), item.data.size());
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                num_reading--;
+                pending_bytes = pending_bytes - item.src.size + item.data.size(); // The file may have changed size since it was listed
+                ready.emplace(index, std::move(item));
+            }
+            cv.notify_all();
+        }
+    }
+
+    std::optional<prefetcher::Item> prefetcher::take(const h5pp::fs::path &path) {
+        // Files are handed out in order, so the ones before path will never be taken
+        auto match = std::find_if(files.begin() + static_cast<std::ptrdiff_t>(num_taken), files.end(), [&path](const FileEntry &f) { return f.path == path; });
+        if(match == files.end()) return std::nullopt;
+        auto                         index  = static_cast<size_t>(std::distance(files.begin(), match));
+        auto                         t_wait = tid::tic_scope("prefetch_wait");
+        std::unique_lock<std::mutex> lock(mutex);
+        while(true) {
+            cv.wait(lock, [&] { return ready.count(num_taken) > 0; });
+            auto node = ready.extract(num_taken);
+            pending_bytes -= node.mapped().data.size();
+            cv.notify_all();
+            if(num_taken++ == index) return std::move(node.mapped());
+            tools::logger::log->debug("Dropping prefetched file {}: the next file is {}", node.mapped().src.path.string(), path.string());
+        }
+    }
+
+    namespace internal {
+        bool copy_file(const h5pp::fs::path &src, const h5pp::fs::path &dst, std::vector<std::byte> &buffer) {
+            // Large sequential reads from the shared filesystem, and large writes to the local disk
+            int fd_src = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+            if(fd_src < 0) return false;
+            int fd_dst = ::open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+            if(fd_dst < 0) {
+                ::close(fd_src);
+                return false;
+            }
+            ::posix_fadvise(fd_src, 0, 0, POSIX_FADV_SEQUENTIAL);
+            bool  ok     = true;
+            off_t offset = 0;
+            while(ok) {
+                auto num = ::pread(fd_src, buffer.data(), buffer.size(), offset);
+                if(num < 0 and errno == EINTR) continue;
+                if(num <= 0) {
+                    ok = num == 0;
+                    break;
+                }
+                for(ssize_t done = 0; done < num;) {
+                    auto put = ::pwrite(fd_dst, buffer.data() + done, static_cast<size_t>(num - done), offset + done);
+                    if(put < 0 and errno == EINTR) continue;
+                    if(put <= 0) {
+                        ok = false;
+                        break;
+                    }
+                    done += put;
+                }
+                offset += num;
+            }
+            ::posix_fadvise(fd_src, 0, 0, POSIX_FADV_DONTNEED); // Only the local copy is read from now on
+            ::close(fd_src);
+            if(::close(fd_dst) != 0) ok = false;
+            if(not ok) ::unlink(dst.c_str());
+            return ok;
+        }
+
+        uintmax_t available_memory() {
+            // Free memory and buffers, which the readahead should not crowd out. Cached pages are not counted: we may well evict those
+            struct sysinfo info {};
+            if(sysinfo(&info) != 0) return std::numeric_limits<uintmax_t>::max();
+            return (static_cast<uintmax_t>(info.freeram) + static_cast<uintmax_t>(info.bufferram)) * info.mem_unit;
+        }
+        void advise_willneed(const h5pp::fs::path &path) {
+            int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if(fd < 0) return;
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+            ::close(fd);
+        }
+    }
+
+    stager::stager(std::vector<FileEntry> files_, const h5pp::fs::path &dir_, uintmax_t max_bytes_, concurrency *control_)
+        : files(std::move(files_)), dir(dir_), max_bytes(max_bytes_), control(control_) {
+        h5pp::fs::create_directories(dir);
+        auto num_workers = std::min(control ? control->get_max_limit() : size_t{1}, std::max<size_t>(files.size(), 1));
+        for(size_t i = 0; i < num_workers; i++) workers.emplace_back(&stager::run, this);
+    }
+
+    stager::~stager() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        cv.notify_all();
+        for(auto &worker : workers)
+            if(worker.joinable()) worker.join();
+        std::error_code ec;
+        h5pp::fs::remove_all(dir, ec);
+        if(ec) tools::logger::log->warn("Could not remove the staging directory {}: {}", dir.string(), ec.message());
+    }
+
+    void stager::run() {
+        std::vector<std::byte> buffer(8 * 1024 * 1024);
+        while(true) {
+            size_t index;
+            {
+                // Wait for a free slot and room on the local disk. An oversized file is let through once nothing else is staged
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&] {
+                    if(stop or num_claimed >= files.size()) return true;
+                    auto limit = control ? std::max<size_t>(control->get_limit(), 1) : 1;
+                    if(num_copying >= limit) return false;
+                    return pending_bytes == 0 or pending_bytes + files[num_claimed].size <= max_bytes;
+                });
+                if(stop or num_claimed >= files.size()) return;
+                index = num_claimed++;
+                num_copying++;
+                pending_bytes += files[index].size;
+            }
+            // Prefix the index: source files in different directories may have the same name
+            Item item{files[index], dir / fmt::format("{}.{}", index, files[index].path.filename().string()), false};
+            auto t_copy = std::chrono::steady_clock::now();
+            item.ok     = internal::copy_file(item.src.path, item.path, buffer);
+            if(control and item.ok)
+                control->report(concurrency::op::read, std::chrono::duration<double>(std::chrono::steady_clock::now() - t_copy).count(), item.src.size);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                num_copying--;
+                if(not item.ok) pending_bytes -= item.src.size; // Nothing was left on the local disk
+                ready.emplace(index, std::move(item));
+            }
+            cv.notify_all();
+        }
+    }
+
+    void stager::remove(const Item &item) {
+        if(not item.ok) return;
+        std::error_code ec;
+        h5pp::fs::remove(item.path, ec);
+        if(ec) tools::logger::log->warn("Could not remove staged file {}: {}", item.path.string(), ec.message());
+        pending_bytes -= item.src.size;
+    }
+
+    std::optional<stager::Item> stager::take(const h5pp::fs::path &path) {
+        auto match = std::find_if(files.begin() + static_cast<std::ptrdiff_t>(num_taken), files.end(), [&path](const FileEntry &f) { return f.path == path; });
+        if(match == files.end()) return std::nullopt;
+        auto                         index  = static_cast<size_t>(std::distance(files.begin(), match));
+        auto                         t_wait = tid::tic_scope("stage_wait");
+        std::unique_lock<std::mutex> lock(mutex);
+        // The caller is done with the files taken before this one, even if it returned early without releasing them
+        for(const auto &[i, item] : taken) remove(item);
+        taken.clear();
+        while(true) {
+            cv.wait(lock, [&] { return ready.count(num_taken) > 0; });
+            auto node = ready.extract(num_taken);
+            if(num_taken++ == index) {
+                taken.emplace(index, node.mapped());
+                cv.notify_all();
+                return std::move(node.mapped());
+            }
+            tools::logger::log->debug("Dropping staged file {}: the next file is {}", node.mapped().src.path.string(), path.string());
+            remove(node.mapped());
+            cv.notify_all();
+        }
+    }
+
+    void stager::release(const Item &item) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for(auto it = taken.begin(); it != taken.end(); it++) {
+                if(it->second.path != item.path) continue;
+                remove(it->second);
+                taken.erase(it);
+                break;
+            }
+        }
+        cv.notify_all();
+    }
+
+    readahead::readahead(std::vector<FileEntry> files_, size_t max_files_, const concurrency *control_)
+        : files(std::move(files_)), max_files(std::max<size_t>(max_files_, 1)), control(control_) {}
+
+    void readahead::advance(const h5pp::fs::path &path) {
+        auto match = std::find_if(files.begin() + static_cast<std::ptrdiff_t>(num_done), files.end(), [&path](const FileEntry &f) { return f.path == path; });
+        if(match == files.end()) return;
+        auto t_hint = tid::tic_scope("readahead");
+        num_done    = static_cast<size_t>(std::distance(files.begin(), match)) + 1;
+        num_hinted  = std::max(num_hinted, num_done); // The current file is being opened already: do not hint it
+        auto budget = internal::available_memory() / 4;
+        // The files between num_done and num_hinted were advised before and count against the budget
+        uintmax_t bytes = 0;
+        for(size_t i = num_done; i < num_hinted; i++) bytes += files[i].size;
+        // Each hinted file is a read in flight on the filesystem, so the controller has the last word
+        auto limit = control ? std::min(window, std::max<size_t>(control->get_limit(), 1)) : window;
+        while(num_hinted < files.size() and num_hinted < num_done + limit) {
+            bytes += files[num_hinted].size;
+            if(bytes > budget and num_hinted > num_done) break; // Always allow one file
+            internal::advise_willneed(files[num_hinted].path);
+            num_hinted++;
+        }
+    }
+
+    void readahead::report_open(double seconds) {
+        if(fastest < 0 or seconds < fastest) fastest = seconds;
+        if(seconds > 4 * fastest) {
+            // The file was not in memory yet: look further ahead
+            num_fast = 0;
+            window   = std::min(2 * window, max_files);
+        } else if(++num_fast >= 8) {
+            num_fast = 0;
+            window   = std::max<size_t>(window - 1, 1);
+        }
+    }
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <h5pp/details/h5ppFilesystem.h>
+#include <io/concurrency.h>
+#include <io/find.h>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace tools::io {
+    /*! \brief Reads the whole file at path into data with sequential preads. The capacity of data is reused. Size is a hint */
+    [[nodiscard]] bool read_file(const h5pp::fs::path &path, std::vector<std::byte> &data, uintmax_t size);
+
+    /*! \brief Reads upcoming source files into memory on background threads
+     *
+     * The producer threads read the files while the caller merges the previous ones, so that the disk and the CPU are busy at the same time.
+     * The files are handed to the caller in order. They run at most max_files files or max_bytes bytes ahead of the caller.
+     * A file larger than max_bytes is still read, but only on its own.
+     * The number of files read at the same time is set by control, if given, and is one otherwise.
+     * HDF5 is not built thread-safe, so the producers only do plain reads: the caller opens the buffers as HDF5 file images.
+     */
+    class prefetcher {
+        public:
+        struct Item {
+            FileEntry              src;
+            std::vector<std::byte> data;
+            bool                   ok = false; /*!< False if the file could not be read. Then the caller should open it from disk as usual */
+        };
+
+        private:
+        std::vector<FileEntry>   files;
+        size_t                   max_files;
+        uintmax_t                max_bytes;
+        concurrency             *control;
+        std::map<size_t, Item>   ready;             // Read but not taken yet, by index in files
+        uintmax_t                pending_bytes = 0; // Size of the files that are being read or are ready
+        size_t                   num_claimed   = 0; // Files before this index are being read, or have been
+        size_t                   num_reading   = 0; // Number of reads in flight
+        size_t                   num_taken     = 0; // Number of files taken or dropped by the caller
+        bool                     stop          = false;
+        std::mutex               mutex;
+        std::condition_variable  cv;
+        std::vector<std::thread> workers;
+        void                     run();
+
+        public:
+        prefetcher(std::vector<FileEntry> files_, size_t max_files_, uintmax_t max_bytes_, concurrency *control_ = nullptr);
+        ~prefetcher();
+        prefetcher(const prefetcher &)            = delete;
+        prefetcher &operator=(const prefetcher &) = delete;
+
+        [[nodiscard]] std::optional<Item> take(const h5pp::fs::path &path); /*!< Waits for path, dropping any files before it. Nullopt if it is not coming */
+    };
+
+    /*! \brief Copies upcoming source files to a local scratch directory on background threads
+     *
+     * Each file is copied with large sequential reads, so that the random metadata reads of HDF5 hit the local disk instead of a
+     * shared filesystem. The copies are handed to the caller in order, and count against max_bytes until the caller releases them.
+     * A file larger than max_bytes is still copied, but only on its own.
+     * The number of files copied at the same time is set by control, if given, and is one otherwise.
+     * Copies that the caller never releases are deleted when a later file is taken, or by the destructor, along with the scratch directory.
+     */
+    class stager {
+        public:
+        struct Item {
+            FileEntry      src;
+            h5pp::fs::path path;       /*!< The local copy */
+            bool           ok = false; /*!< False if the file could not be copied. Then the caller should open src as usual */
+        };
+
+        private:
+        std::vector<FileEntry>   files;
+        h5pp::fs::path           dir;
+        uintmax_t                max_bytes;
+        concurrency             *control;
+        std::map<size_t, Item>   ready;             // Copied but not taken yet, by index in files
+        std::map<size_t, Item>   taken;             // Taken but not released yet
+        uintmax_t                pending_bytes = 0; // Size of the files that are being copied, or are on the local disk
+        size_t                   num_claimed   = 0; // Files before this index are being copied, or have been
+        size_t                   num_copying   = 0; // Number of copies in flight
+        size_t                   num_taken     = 0; // Number of files taken or dropped by the caller
+        bool                     stop          = false;
+        std::mutex               mutex;
+        std::condition_variable  cv;
+        std::vector<std::thread> workers;
+        void                     run();
+        void                     remove(const Item &item); // Call with the mutex held
+
+        public:
+        stager(std::vector<FileEntry> files_, const h5pp::fs::path &dir_, uintmax_t max_bytes_, concurrency *control_ = nullptr);
+        ~stager();
+        stager(const stager &)            = delete;
+        stager &operator=(const stager &) = delete;
+
+        [[nodiscard]] std::optional<Item> take(const h5pp::fs::path &path); /*!< Waits for path, dropping any files before it. Nullopt if it is not coming */
+        void                              release(const Item &item);        /*!< Deletes the local copy of a taken item, once the caller is done with it */
+    };
+
+    /*! \brief Asks the kernel to read the next few source files into the page cache while the current one is merged
+     *
+     * This is the lightweight alternative to the prefetcher: posix_fadvise(WILLNEED) starts an asynchronous readahead and returns,
+     * so nothing is copied and HDF5 opens the files as usual, only from the page cache.
+     * The window starts at one file and adapts between 1 and max_files:
+     *  - It doubles when an open is much slower than the fastest one seen, i.e. when the data was not in memory yet.
+     *  - It shrinks by one after a run of fast opens, to leave the page cache alone when the disk keeps up.
+     *  - The files in the window never take more than a quarter of the available memory.
+     *  - It never exceeds the limit of control, if given.
+     */
+    class readahead {
+        private:
+        std::vector<FileEntry> files;
+        size_t                 max_files;
+        size_t                 window     = 1;
+        size_t                 num_done   = 0;  // Files up to here have been opened, or skipped
+        size_t                 num_hinted = 0;  // Files up to here have been advised
+        double                 fastest    = -1; // Fastest open latency seen, in seconds. Negative until the first one
+        size_t                 num_fast   = 0;  // Consecutive fast opens
+        const concurrency     *control;
+
+        public:
+        readahead(std::vector<FileEntry> files_, size_t max_files_, const concurrency *control_ = nullptr);
+        void                 advance(const h5pp::fs::path &path); /*!< Call before opening path: advises the files after it */
+        void                 report_open(double seconds);         /*!< Call with the time it took to open the last file */
+        [[nodiscard]] size_t get_window() const { return window; }
+    };
+}
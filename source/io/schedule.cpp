@@ -0,0 +1,288 @@
+#include "schedule.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <general/human.h>
+#include <general/iter.h>
+#include <h5pp/h5pp.h>
+#include <io/find.h>
+#include <io/h5db.h>
+#include <io/hash.h>
+#include <io/logger.h>
+#include <io/parse.h>
+#include <mpi/mpi-tools.h>
+#include <mutex>
+#include <numeric>
+#include <queue>
+#include <thread>
+#include <tid/tid.h>
+
+namespace tools::schedule {
+    namespace internal {
+        // Opening a source file and reading its metadata costs about as much as reading this many bytes
+        constexpr double cost_per_file = 4.0 * 1024 * 1024;
+        // A file that is already UPTODATE is only hashed and looked up in the database
+        constexpr double cost_per_uptodate = 4.0 * 1024;
+
+        template<typename T>
+        void pack_value(std::string &buf, const T &value) {
+            buf.append(reinterpret_cast<const char *>(&value), sizeof(T));
+        }
+        template<typename T>
+        T unpack_value(std::string_view buf, size_t &pos) {
+            T value;
+            if(pos + sizeof(T) > buf.size()) throw std::runtime_error(h5pp::format("unpack_value: buffer too short: {} < {}", buf.size(), pos + sizeof(T)));
+            std::memcpy(&value, buf.data() + pos, sizeof(T));
+            pos += sizeof(T);
+            return value;
+        }
+
+        // Packs a DirCost (except the h5dir, which every rank knows by its index) into a string, so that it can be sent with mpi::allgatherv
+        std::string pack_cost(size_t index, const DirCost &cost) {
+            std::string buf;
+            buf.reserve(6 * sizeof(size_t) + cost.seeds.size() * sizeof(long));
+            pack_value(buf, index);
+            pack_value(buf, cost.files);
+            pack_value(buf, cost.uptodate);
+            pack_value(buf, cost.bytes);
+            pack_value(buf, cost.pending);
+            pack_value(buf, cost.cost);
+            pack_value(buf, cost.fresh);
+            pack_value(buf, cost.seeds.size());
+            for(const auto &seed : cost.seeds) pack_value(buf, seed);
+            return buf;
+        }
+
+        DirCost unpack_cost(std::string_view buf, size_t &index) {
+            DirCost cost;
+            size_t  pos   = 0;
+            index         = unpack_value<size_t>(buf, pos);
+            cost.files    = unpack_value<size_t>(buf, pos);
+            cost.uptodate = unpack_value<size_t>(buf, pos);
+            cost.bytes    = unpack_value<uintmax_t>(buf, pos);
+            cost.pending  = unpack_value<uintmax_t>(buf, pos);
+            cost.cost     = unpack_value<double>(buf, pos);
+            cost.fresh    = unpack_value<bool>(buf, pos);
+            cost.seeds.resize(unpack_value<size_t>(buf, pos));
+            for(auto &seed : cost.seeds) seed = unpack_value<long>(buf, pos);
+            return cost;
+        }
+
+        DirCost estimate_cost(const h5pp::fs::path &h5dir, const std::vector<tools::io::FileEntry> &listing, const TgtPathFn &get_tgt_path, bool rescan,
+                              size_t verbosity_h5pp) {
+            DirCost cost;
+            cost.h5dir = h5dir;
+            cost.files = listing.size();
+
+            std::unordered_map<std::string, FileId> fileDb;
+            bool                                    unchanged = false;
+            auto                                    tgt_path  = get_tgt_path(h5dir);
+            cost.fresh                                        = tgt_path.empty() or not h5pp::fs::exists(tgt_path);
+            if(not cost.fresh) {
+                try {
+                    auto h5_tgt = h5pp::File(tgt_path, h5pp::FilePermission::READONLY, verbosity_h5pp);
+                    // merge_dir skips a directory whose manifest matches, so there is no need to hash its files here
+                    if(not rescan) {
+                        auto manifestId = tools::h5db::loadManifest(h5_tgt);
+                        unchanged       = manifestId and manifestId.value() == tools::h5db::getManifestId(h5dir, listing);
+                    }
+                    if(not unchanged) fileDb = tools::h5db::loadFileDatabase(h5_tgt);
+                } catch(const std::exception &ex) { tools::logger::log->warn("Could not read file database in [{}]: {}", tgt_path, ex.what()); }
+            }
+            for(const auto &src : listing) {
+                auto seed = tools::parse::extract_digits_from_h5_filename<long>(src.path.filename());
+                cost.seeds.emplace_back(seed);
+                cost.bytes += src.size;
+                bool uptodate = unchanged;
+                if(not uptodate and not fileDb.empty()) {
+                    FileId fileId(seed, src.path.string(), tools::hash::hash_file_meta(src.path, src.mtime));
+                    try {
+                        uptodate = tools::h5db::getFileIdStatus(fileDb, fileId) == FileIdStatus::UPTODATE;
+                    } catch(const std::exception &ex) { tools::logger::log->debug("Could not get status of [{}]: {}", src.path.string(), ex.what()); }
+                }
+                if(uptodate) {
+                    cost.uptodate++;
+                } else {
+                    cost.pending += src.size;
+                }
+            }
+            std::sort(cost.seeds.begin(), cost.seeds.end());
+            cost.cost = static_cast<double>(cost.pending) + cost_per_file * static_cast<double>(cost.files - cost.uptodate) +
+                        cost_per_uptodate * static_cast<double>(cost.uptodate);
+            tools::logger::log->debug("Cost of {}: files {} | uptodate {} | unchanged {} | bytes {} | pending {} | cost {:.3e}", h5dir.string(), cost.files,
+                                      cost.uptodate, unchanged, cost.bytes, cost.pending, cost.cost);
+            return cost;
+        }
+    }
+
+    /*! \brief Estimates the merge cost of each h5dir found on id 0, and returns the costs on all ids, in the same order.
+     *
+     * This is a collective call. The directories are shared among the ids, which each list and cost their own share,
+     * so that the target files are read in parallel. The costs are then gathered on all ids.
+     */
+    std::vector<DirCost> estimate_costs(const std::vector<h5pp::fs::path> &h5dirs, const TgtPathFn &get_tgt_path, bool rescan, size_t num_threads,
+                                        size_t verbosity_h5pp) {
+        auto                     t_scope = tid::tic_scope(__FUNCTION__);
+        std::vector<std::string> all_dirs;
+        if(mpi::world.id == 0)
+            for(const auto &h5dir : h5dirs) all_dirs.emplace_back(h5dir.string());
+        mpi::allgatherv(all_dirs);
+
+        std::vector<size_t> own; // Indices into all_dirs costed on this id
+        for(size_t i = mpi::world.get_id<size_t>(); i < all_dirs.size(); i += mpi::world.get_size<size_t>()) own.emplace_back(i);
+        std::vector<std::vector<tools::io::FileEntry>> listings(own.size());
+
+        // The listings are I/O bound, so we do them in parallel
+        std::atomic<size_t> next = 0;
+        std::exception_ptr  error;
+        std::mutex          error_mtx;
+        auto                list = [&]() {
+            for(size_t i = next++; i < own.size(); i = next++) {
+                try {
+                    listings[i] = tools::io::list_h5_files(all_dirs[own[i]]);
+                } catch(...) {
+                    std::lock_guard<std::mutex> lock(error_mtx);
+                    if(not error) error = std::current_exception();
+                }
+            }
+        };
+        std::vector<std::thread> workers;
+        for(size_t worker = 0; worker < std::max<size_t>(num_threads, 1ul); worker++) workers.emplace_back(list);
+        for(auto &w : workers) w.join();
+        if(error) std::rethrow_exception(error);
+
+        // HDF5 is not thread safe, so the file databases of the targets are read serially on each id
+        std::vector<std::string> packed;
+        packed.reserve(own.size());
+        for(const auto &[i, index] : iter::enumerate(own))
+            packed.emplace_back(internal::pack_cost(index, internal::estimate_cost(all_dirs[index], listings[i], get_tgt_path, rescan, verbosity_h5pp)));
+        mpi::allgatherv(packed);
+
+        std::vector<DirCost> costs(all_dirs.size());
+        for(const auto &buf : packed) {
+            size_t index = 0;
+            auto   cost  = internal::unpack_cost(buf, index);
+            if(index >= costs.size()) throw std::runtime_error(h5pp::format("estimate_costs: index {} out of range {}", index, costs.size()));
+            cost.h5dir   = all_dirs[index];
+            costs[index]   = std::move(cost);
+        }
+        return costs;
+    }
+
+    h5pp::fs::path get_slice_path(const Slice &slice) {
+        if(not slice.is_split()) return slice.h5dir;
+        return slice.h5dir / h5pp::format(".slice-{}-of-{}.seeds-{}-{}", slice.index, slice.count, slice.seed_min, slice.seed_max);
+    }
+
+    Slice parse_slice_path(const h5pp::fs::path &path) {
+        Slice slice;
+        auto  name = path.filename().string();
+        if(std::sscanf(name.c_str(), ".slice-%zu-of-%zu.seeds-%ld-%ld", &slice.index, &slice.count, &slice.seed_min, &slice.seed_max) == 4) {
+            slice.h5dir = path.parent_path();
+            return slice;
+        }
+        return Slice{path};
+    }
+
+    /*! \brief Splits directories with more than split_files files into seed-range slices of about split_files each.
+     *
+     * Only fresh directories are split: when the target exists, only the new files are merged, and that is best done in one place.
+     * The seed ranges of the slices cover all seeds, so that files that appear later still belong to exactly one slice.
+     */
+    std::vector<DirCost> split_costs(const std::vector<DirCost> &costs, size_t split_files) {
+        if(split_files == 0) return costs;
+        std::vector<DirCost> result;
+        for(const auto &cost : costs) {
+            if(not cost.fresh or cost.files <= split_files) {
+                result.emplace_back(cost);
+                continue;
+            }
+            auto num_slices = (cost.files + split_files - 1) / split_files;
+            auto first      = [&](size_t index) { return index * cost.files / num_slices; }; // Index of the first seed in each slice
+            for(size_t index = 0; index < num_slices; index++) {
+                Slice slice{cost.h5dir, index, num_slices};
+                if(index > 0) slice.seed_min = cost.seeds[first(index)];
+                if(index + 1 < num_slices) slice.seed_max = cost.seeds[first(index + 1)] - 1;
+                auto  files = first(index + 1) - first(index);
+                auto  share = static_cast<double>(files) / static_cast<double>(cost.files);
+                auto &part  = result.emplace_back();
+                part.h5dir  = get_slice_path(slice);
+                part.files  = files;
+                part.bytes  = static_cast<uintmax_t>(share * static_cast<double>(cost.bytes));
+                part.pending = part.bytes;
+                part.cost   = share * cost.cost;
+            }
+            tools::logger::log->info("Split {} files in {} into {} slices", cost.files, cost.h5dir.string(), num_slices);
+        }
+        return result;
+    }
+
+    /*! \brief Assigns each directory to a rank, longest-processing-time first.
+     *
+     * The directories are taken in order of decreasing cost, and each is given to the rank with the least load so far.
+     * The resulting makespan is at most 4/3 of the optimum.
+     */
+    std::vector<int> assign_lpt(const std::vector<DirCost> &costs, int num_ranks) {
+        auto                t_scope = tid::tic_scope(__FUNCTION__);
+        std::vector<size_t> order(costs.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&costs](size_t lhs, size_t rhs) { return costs[lhs].cost > costs[rhs].cost; });
+
+        using load_t = std::pair<double, int>; // Accumulated cost and rank id. Ties go to the lowest rank id
+        std::priority_queue<load_t, std::vector<load_t>, std::greater<load_t>> loads;
+        for(int id = 0; id < num_ranks; id++) loads.emplace(0.0, id);
+
+        std::vector<int> assignment(costs.size(), 0);
+        for(const auto &idx : order) {
+            auto [load, id] = loads.top();
+            loads.pop();
+            assignment[idx] = id;
+            loads.emplace(load + costs[idx].cost, id);
+        }
+        return assignment;
+    }
+
+    /*! \brief Sorts the h5dirs found on id 0 in order of decreasing estimated cost, and returns the costs in the same order on id 0.
+     *
+     * This is a collective call, since the costs are estimated on all ids.
+     */
+    std::vector<DirCost> sort_by_cost(std::vector<h5pp::fs::path> &h5dirs, const TgtPathFn &get_tgt_path, bool rescan, size_t split_files,
+                                      size_t num_threads, size_t verbosity_h5pp) {
+        if(mpi::world.size == 1) return {}; // The order only matters when there are several ranks to share the work
+        auto t_scope = tid::tic_scope(__FUNCTION__);
+        auto costs   = estimate_costs(h5dirs, get_tgt_path, rescan, num_threads, verbosity_h5pp);
+        if(mpi::world.id != 0) return {};
+        costs = split_costs(costs, split_files);
+        std::stable_sort(costs.begin(), costs.end(), [](const DirCost &lhs, const DirCost &rhs) { return lhs.cost > rhs.cost; });
+        h5dirs.resize(costs.size());
+        for(const auto &[i, cost] : iter::enumerate(costs)) h5dirs[i] = cost.h5dir;
+        return costs;
+    }
+
+    /*! \brief Distributes the h5dirs found on id 0 to all ranks, balancing the estimated cost.
+     *
+     * Each rank gets its directories in order of decreasing cost.
+     */
+    void distribute_lpt(std::vector<h5pp::fs::path> &h5dirs, const TgtPathFn &get_tgt_path, bool rescan, size_t split_files, size_t num_threads,
+                        size_t verbosity_h5pp) {
+        if(mpi::world.size == 1) return;
+        auto             t_scope = tid::tic_scope(__FUNCTION__);
+        auto             costs   = sort_by_cost(h5dirs, get_tgt_path, rescan, split_files, num_threads, verbosity_h5pp);
+        std::vector<int> assignment;
+        if(mpi::world.id == 0) {
+            assignment = assign_lpt(costs, mpi::world.size);
+
+            std::vector<double> loads(mpi::world.get_size<size_t>(), 0.0);
+            std::vector<size_t> counts(mpi::world.get_size<size_t>(), 0);
+            for(const auto &[i, id] : iter::enumerate(assignment)) {
+                loads[static_cast<size_t>(id)] += costs[i].cost;
+                counts[static_cast<size_t>(id)] += 1;
+            }
+            for(const auto &[id, load] : iter::enumerate(loads))
+                tools::logger::log->info("Scheduled {} directories on id {} | estimated cost {}", counts[id], id,
+                                         tools::fmtBytes(true, static_cast<size_t>(load), 1024, 1));
+        }
+        mpi::scatter(h5dirs, assignment, 0);
+    }
+}
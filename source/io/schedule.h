@@ -0,0 +1,50 @@
+#pragma once
+
+#include <functional>
+#include <h5pp/details/h5ppFilesystem.h>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace tools::schedule {
+    /*! \brief Estimated merge cost of one h5dir */
+    struct DirCost {
+        h5pp::fs::path    h5dir;
+        size_t            files    = 0;    /*!< Number of .h5 files */
+        size_t            uptodate = 0;    /*!< Number of files already UPTODATE in the target file database */
+        uintmax_t         bytes    = 0;    /*!< Total size of the files */
+        uintmax_t         pending  = 0;    /*!< Total size of the files that are not UPTODATE */
+        double            cost     = 0;    /*!< Estimated cost in units of bytes read */
+        bool              fresh    = true; /*!< The target does not exist yet (or is replaced), so nothing has been merged */
+        std::vector<long> seeds;           /*!< Sorted seeds of the .h5 files */
+    };
+
+    /*! \brief A seed range of an h5dir, merged on its own into a partial target.
+     *
+     * Huge directories are split into slices so that several ranks can work on them at once.
+     * A slice travels between ranks as a path: h5dir/.slice-<index>-of-<count>.seeds-<seed_min>-<seed_max>.
+     * A plain h5dir is a single slice covering every seed.
+     */
+    struct Slice {
+        h5pp::fs::path     h5dir;
+        size_t             index    = 0;
+        size_t             count    = 1;
+        long               seed_min = std::numeric_limits<long>::min();
+        long               seed_max = std::numeric_limits<long>::max();
+        [[nodiscard]] bool contains(long seed) const { return seed >= seed_min and seed <= seed_max; }
+        [[nodiscard]] bool is_split() const { return count > 1; }
+    };
+    [[nodiscard]] h5pp::fs::path get_slice_path(const Slice &slice);
+    [[nodiscard]] Slice          parse_slice_path(const h5pp::fs::path &path);
+
+    using TgtPathFn = std::function<std::string(const h5pp::fs::path &h5dir)>; /*!< Returns the target file of h5dir, or empty to skip the lookup */
+
+    std::vector<DirCost> estimate_costs(const std::vector<h5pp::fs::path> &h5dirs, const TgtPathFn &get_tgt_path, bool rescan, size_t num_threads,
+                                        size_t verbosity_h5pp);
+    std::vector<int>     assign_lpt(const std::vector<DirCost> &costs, int num_ranks);
+    std::vector<DirCost> split_costs(const std::vector<DirCost> &costs, size_t split_files);
+    std::vector<DirCost> sort_by_cost(std::vector<h5pp::fs::path> &h5dirs, const TgtPathFn &get_tgt_path, bool rescan, size_t split_files,
+                                      size_t num_threads, size_t verbosity_h5pp);
+    void distribute_lpt(std::vector<h5pp::fs::path> &h5dirs, const TgtPathFn &get_tgt_path, bool rescan, size_t split_files, size_t num_threads,
+                        size_t verbosity_h5pp);
+}
@@ -0,0 +1,157 @@
+#include "validate.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <hdf5.h>
+#include <io/logger.h>
+#include <iostream>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <thread>
+#include <tid/tid.h>
+#include <unistd.h>
+
+extern char **environ;
+
+namespace tools::validate {
+    std::string_view reason(Validity validity) {
+        switch(validity) {
+            case Validity::UNKNOWN: return "Not checked";
+            case Validity::OK: return "Valid";
+            case Validity::BROKEN: return "Could not open file";
+            case Validity::NO_FINISHED_ALL: return "Could not find dataset [common/finished_all]";
+            case Validity::NOT_FINISHED: return "Simulation has not finished";
+            case Validity::NO_ALGO: return "Could not find any algorithm group";
+        }
+        return "Unknown";
+    }
+
+    namespace internal {
+        Validity check_file(const h5pp::fs::path &path, const std::vector<std::string> &algos, bool require_finished) {
+            // Plain HDF5 calls, without h5pp, since this runs in a helper process with errors silenced
+            hid_t file = H5Fopen(path.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+            if(file < 0) return Validity::BROKEN;
+            auto validity = Validity::OK;
+            if(H5Lexists(file, "common", H5P_DEFAULT) <= 0 or H5Lexists(file, "common/finished_all", H5P_DEFAULT) <= 0) {
+                validity = Validity::NO_FINISHED_ALL;
+            } else if(require_finished) {
+                hbool_t finished_all = false;
+                hid_t   dset         = H5Dopen(file, "common/finished_all", H5P_DEFAULT);
+                if(dset < 0 or H5Dread(dset, H5T_NATIVE_HBOOL, H5S_ALL, H5S_ALL, H5P_DEFAULT, &finished_all) < 0)
+                    validity = Validity::BROKEN;
+                else if(not finished_all)
+                    validity = Validity::NOT_FINISHED;
+                if(dset >= 0) H5Dclose(dset);
+            }
+            if(validity == Validity::OK and not algos.empty()) {
+                validity = Validity::NO_ALGO;
+                for(const auto &algo : algos)
+                    if(H5Lexists(file, algo.c_str(), H5P_DEFAULT) > 0) validity = Validity::OK;
+            }
+            H5Fclose(file);
+            return validity;
+        }
+    }
+
+    int run_helper(int argc, char *argv[]) {
+        // argv: <exe> helper_flag <require_finished> <algo>...
+        if(argc < 3 or std::string_view(argv[1]) != helper_flag) return 2;
+        bool                     require_finished = std::string_view(argv[2]) == "1";
+        std::vector<std::string> algos(argv + 3, argv + argc);
+        H5Eset_auto(H5E_DEFAULT, nullptr, nullptr);
+        std::string path;
+        while(std::getline(std::cin, path, '\0')) std::cout << static_cast<int>(internal::check_file(path, algos, require_finished)) << std::endl;
+        return 0;
+    }
+
+    namespace internal {
+        // Sends a path to the helper on fd and reads back its verdict. Returns UNKNOWN if the helper has gone away.
+        // The path is NUL-terminated: a file name may contain a newline, but not a NUL
+        Validity ask_helper(int fd, const h5pp::fs::path &path) {
+            auto line = path.string() + '\0';
+            for(size_t sent = 0; sent < line.size();) {
+                auto num = send(fd, line.data() + sent, line.size() - sent, MSG_NOSIGNAL); // No SIGPIPE if the helper has crashed
+                if(num < 0 and errno == EINTR) continue;
+                if(num <= 0) return Validity::UNKNOWN;
+                sent += static_cast<size_t>(num);
+            }
+            std::string reply;
+            char        c = 0;
+            while(true) {
+                auto num = recv(fd, &c, 1, 0);
+                if(num < 0 and errno == EINTR) continue;
+                if(num <= 0) return Validity::UNKNOWN;
+                if(c == '\n') break;
+                reply.push_back(c);
+            }
+            auto value = std::strtol(reply.c_str(), nullptr, 10);
+            if(reply.empty() or value < 0 or value > static_cast<long>(Validity::NO_ALGO)) return Validity::UNKNOWN;
+            return static_cast<Validity>(value);
+        }
+    }
+
+    std::vector<Validity> check_files(const std::vector<tools::io::FileEntry> &files, const std::vector<std::string> &algos, bool require_finished,
+                                      size_t num_procs) {
+        std::vector<Validity> result(files.size(), Validity::UNKNOWN);
+        if(files.empty() or num_procs == 0) return result;
+        auto t_scope = tid::tic_scope(__FUNCTION__);
+        num_procs    = std::min(num_procs, files.size());
+
+        // The helpers are fresh h5mbl processes, started with posix_spawn rather than fork(): after MPI_Init, a forked child would share
+        // the pinned pages of the MPI transport copy-on-write, along with the HDF5 state of the open target file.
+        std::string              exe = h5pp::fs::read_symlink("/proc/self/exe").string();
+        std::vector<std::string> args = {exe, std::string(helper_flag), require_finished ? "1" : "0"};
+        args.insert(args.end(), algos.begin(), algos.end());
+        std::vector<char *> argp;
+        for(auto &arg : args) argp.emplace_back(arg.data());
+        argp.emplace_back(nullptr);
+
+        struct helper_t {
+            pid_t pid = -1;
+            int   fd  = -1; // Our end of the socket that is the stdin and stdout of the helper
+        };
+        std::vector<helper_t> helpers;
+        for(size_t proc = 0; proc < num_procs; proc++) {
+            int fds[2];
+            if(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+                tools::logger::log->warn("Validation runs with {} processes: socketpair failed: {}", helpers.size(), std::strerror(errno));
+                break;
+            }
+            posix_spawn_file_actions_t actions;
+            posix_spawn_file_actions_init(&actions);
+            posix_spawn_file_actions_adddup2(&actions, fds[1], STDIN_FILENO);
+            posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+            pid_t pid = -1;
+            int   err = posix_spawn(&pid, exe.c_str(), &actions, nullptr, argp.data(), environ);
+            posix_spawn_file_actions_destroy(&actions);
+            close(fds[1]);
+            if(err != 0) {
+                close(fds[0]);
+                tools::logger::log->warn("Validation runs with {} processes: posix_spawn failed: {}", helpers.size(), std::strerror(err));
+                break;
+            }
+            helpers.push_back({pid, fds[0]});
+        }
+
+        // Each helper checks every num_procs'th file, one at a time, driven by its own thread
+        std::vector<std::thread> threads;
+        for(size_t proc = 0; proc < helpers.size(); proc++) {
+            threads.emplace_back([&, proc, fd = helpers[proc].fd]() {
+                for(size_t i = proc; i < files.size(); i += helpers.size()) {
+                    result[i] = internal::ask_helper(fd, files[i].path);
+                    if(result[i] == Validity::UNKNOWN) break; // The rest are checked as usual
+                }
+            });
+        }
+        for(auto &t : threads) t.join();
+        for(const auto &helper : helpers) {
+            close(helper.fd); // The helper sees end of input and exits
+            int status = 0;
+            while(waitpid(helper.pid, &status, 0) < 0 and errno == EINTR) {}
+            if(not WIFEXITED(status) or WEXITSTATUS(status) != 0) tools::logger::log->warn("Validation process {} failed", helper.pid);
+        }
+        return result;
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+#include <io/find.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tools::validate {
+    enum class Validity : std::uint8_t { UNKNOWN, OK, BROKEN, NO_FINISHED_ALL, NOT_FINISHED, NO_ALGO };
+
+    [[nodiscard]] std::string_view reason(Validity validity);
+
+    /*! \brief Command line flag that starts h5mbl as a validation helper for check_files */
+    constexpr std::string_view helper_flag = "--validate-helper";
+
+    /*! \brief Runs a validation helper: reads NUL-terminated paths on stdin, and writes one Validity per line on stdout.
+     *
+     * Call this before MPI or anything else is initialized. Returns the exit code.
+     */
+    int run_helper(int argc, char *argv[]);
+
+    /*! \brief Checks that the source files can be merged, in num_procs helper processes
+     *
+     * Each file is opened read-only and checked for common/finished_all (and that it is true, if require_finished),
+     * and for at least one of the algorithm groups in algos.
+     * HDF5 is not built thread-safe, so the work is split over helper processes, spawned from this executable, that get paths and return verdicts
+     * through a socket. Files that could not be checked, e.g. because a helper failed, are left UNKNOWN and should be checked as usual.
+     */
+    [[nodiscard]] std::vector<Validity> check_files(const std::vector<tools::io::FileEntry> &files, const std::vector<std::string> &algos,
+                                                    bool require_finished, size_t num_procs);
+}
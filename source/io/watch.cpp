@@ -0,0 +1,67 @@
+#include "watch.h"
+#include <algorithm>
+#include <array>
+#include <csignal>
+#include <cstring>
+#include <h5pp/details/h5ppFormat.h>
+#include <io/logger.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <tid/tid.h>
+#include <unistd.h>
+
+namespace tools::watch {
+    namespace internal {
+        volatile std::sig_atomic_t stop = 0;
+        extern "C" void            stop_callback_handler(int) { stop = 1; }
+    }
+
+    inotify::inotify() {
+        fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if(fd < 0) throw std::runtime_error(h5pp::format("inotify_init1 failed: {}", std::strerror(errno)));
+    }
+    inotify::~inotify() {
+        if(fd >= 0) close(fd);
+    }
+
+    void inotify::add(const h5pp::fs::path &dir) {
+        // Simulations either write and close their .h5 files in place, or write elsewhere and move them in
+        int wd = inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if(wd < 0) throw std::runtime_error(h5pp::format("inotify_add_watch failed on [{}]: {}", dir.string(), std::strerror(errno)));
+        dirs[wd] = dir;
+    }
+
+    std::vector<h5pp::fs::path> inotify::read(int timeout_ms) {
+        auto                        t_scope = tid::tic_scope(__FUNCTION__);
+        std::vector<h5pp::fs::path> result;
+        pollfd                      pfd{fd, POLLIN, 0};
+        if(poll(&pfd, 1, timeout_ms) <= 0) return result; // Timeout or interrupted by a signal
+        alignas(inotify_event) std::array<char, 64 * 1024> buf = {};
+        while(true) {
+            auto len = ::read(fd, buf.data(), buf.size());
+            if(len <= 0) break; // EAGAIN: No more events queued
+            for(char *ptr = buf.data(); ptr < buf.data() + len;) {
+                auto *event = reinterpret_cast<inotify_event *>(ptr);
+                ptr += sizeof(inotify_event) + event->len;
+                if(event->mask & IN_Q_OVERFLOW) tools::logger::log->warn("inotify queue overflow: some events were lost");
+                if(event->len == 0 or event->mask & IN_ISDIR) continue;
+                auto dir = dirs.find(event->wd);
+                if(dir == dirs.end()) continue;
+                auto path = dir->second / event->name;
+                if(path.extension() == ".h5") result.emplace_back(path);
+            }
+        }
+        // The same file may have been closed several times since the last read
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+        return result;
+    }
+
+    void register_stop_signals() {
+        // Override the default callbacks, so that we can finish the current file and save the databases before exiting
+        std::signal(SIGINT, internal::stop_callback_handler);
+        std::signal(SIGTERM, internal::stop_callback_handler);
+    }
+
+    bool stop_requested() { return internal::stop != 0; }
+}
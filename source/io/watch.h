@@ -0,0 +1,29 @@
+#pragma once
+
+#include <h5pp/details/h5ppFilesystem.h>
+#include <unordered_map>
+#include <vector>
+
+namespace tools::watch {
+    /*! \brief RAII wrapper around a Linux inotify instance
+     *
+     * Reports .h5 files that have been closed after writing, or moved into, any of the watched directories.
+     */
+    class inotify {
+        private:
+        int                                     fd = -1;
+        std::unordered_map<int, h5pp::fs::path> dirs; // Maps watch descriptors to directories
+
+        public:
+        inotify();
+        ~inotify();
+        inotify(const inotify &)            = delete;
+        inotify &operator=(const inotify &) = delete;
+
+        void                                      add(const h5pp::fs::path &dir);
+        [[nodiscard]] std::vector<h5pp::fs::path> read(int timeout_ms); /*!< Waits for events, then returns the sorted unique .h5 files */
+    };
+
+    void               register_stop_signals();
+    [[nodiscard]] bool stop_requested();
+}
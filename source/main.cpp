@@ -9,19 +9,27 @@
 #include <getopt.h>
 #include <gitversion.h>
 #include <h5pp/h5pp.h>
+#include <io/concurrency.h>
 #include <io/find.h>
 #include <io/h5db.h>
 #include <io/h5dbg.h>
 #include <io/h5io.h>
+#include <io/h5vfd.h>
 #include <io/hash.h>
 #include <io/id.h>
 #include <io/logger.h>
 #include <io/meta.h>
 #include <io/parse.h>
+#include <io/prefetch.h>
+#include <io/schedule.h>
+#include <io/validate.h>
+#include <io/watch.h>
+#include <mpi/mpi-queue.h>
 #include <mpi/mpi-tools.h>
 #include <omp.h>
 #include <string>
 #include <tid/tid.h>
+#include <unordered_set>
 
 template<typename T>
 void append_dset(h5pp::File &h5_tgt, const h5pp::File &h5_src, h5pp::DsetInfo &tgtInfo, h5pp::DsetInfo &srcInfo) {
@@ -53,7 +61,40 @@ void clean_up() {
     H5Eprint(H5E_DEFAULT, stderr);
 }
 
+void create_link_file(const h5pp::fs::path &tgt_dir, const std::string &tgt_file, Model model, size_t verbosity_h5pp) {
+    // Make a main file with external links to all the targets in tgt_dir
+    auto tgt_path = tgt_dir / tgt_file;
+    tools::logger::log->info("Creating main file for external links: {}", tgt_path);
+    auto h5_tgt   = h5pp::File(tgt_path, h5pp::FilePermission::REPLACE, verbosity_h5pp);
+    auto tgt_stem = h5pp::fs::path(tgt_file).stem().string();
+    auto tgt_algo = model == Model::LBIT ? "fLBIT" : "xDMRG";
+    for(const auto &obj : h5pp::fs::directory_iterator(tgt_dir, h5pp::fs::directory_options::follow_directory_symlink)) {
+        if(obj.is_regular_file() and obj.path().extension() == ".h5") {
+            if(obj.path().filename() != tgt_file and obj.path().stem().string().find(tgt_stem) != std::string::npos) {
+                // Found a file that we can link!
+                auto h5_ext = h5pp::File(obj.path().string(), h5pp::FilePermission::READONLY, verbosity_h5pp);
+                // Find the path to the algorithm in this external file
+                auto algo_group = h5_ext.findGroups(tgt_algo, "/", 1);
+                if(algo_group.empty()) {
+                    tools::logger::log->error("Could not find algo group {} in external file {}: [{}]", tgt_algo, obj.path().string(), algo_group);
+                    continue;
+                    //                        throw std::runtime_error(
+                    //                            h5pp::format("Could not find algo group {} in external file {}: [{}]", tgt_algo, obj.path().string(),
+                    //                            algo_group));
+                }
+
+                auto tgt_link = h5pp::fs::proximate(obj.path(), tgt_dir);
+                tools::logger::log->info("Creating external link: {} -> {}", algo_group[0], tgt_link.string());
+                h5_tgt.createExternalLink(tgt_link.string(), algo_group[0], algo_group[0]);
+            }
+        }
+    }
+}
+
 int main(int argc, char *argv[]) {
+    // Spawned by tools::validate::check_files: check the files given on stdin, without initializing MPI
+    if(argc > 1 and std::string_view(argv[1]) == tools::validate::helper_flag) return tools::validate::run_helper(argc, argv);
+
     // Here we use getopt to parse CLI input
     // Note that CLI input always override config-file values
     // wherever they are found (config file, h5 file)
@@ -65,17 +106,34 @@ int main(int argc, char *argv[]) {
     std::string                 tgt_file = "merged.h5";
     h5pp::fs::path              tgt_dir;
     h5pp::fs::path              tmp_dir        = h5pp::fs::absolute(fmt::format("/tmp/{}", tools::h5io::get_tmp_dirname(argv[0])));
+    h5pp::fs::path              stage_dir;
     bool                        finished       = false;
     bool                        link_only      = false;
     bool                        use_tmp        = false;
+    bool                        src_mmap       = false;
+    bool                        src_profile    = true;
+    bool                        crono2d        = false;
     size_t                      verbosity      = 2;
     size_t                      verbosity_h5pp = 2;
     size_t                      max_files      = 0ul;
     size_t                      max_dirs       = 0ul;
+    size_t                      split_files    = 0ul;
+    size_t                      prefetch_files = 0ul;
+    size_t                      prefetch_mb    = 512ul;
+    size_t                      src_image_mb   = 0ul;
+    size_t                      stage_mb       = 4096ul;
+    size_t                      readahead_max  = 0ul;
+    size_t                      inflight_max   = 4ul;
+    size_t                      validate_procs = 0ul;
+    size_t                      num_threads    = 8ul;
     long                        seed_min       = 0l;
     long                        seed_max       = std::numeric_limits<long>::max();
     Model                       model          = Model::SDUAL;
+    Schedule                    schedule       = Schedule::STATIC;
     bool                        replace        = false;
+    bool                        rescan         = false;
+    bool                        watch          = false;
+    double                      flush_every    = 60.0;
     std::vector<std::string>    incfilter      = {};
     std::vector<std::string>    excfilter      = {};
     {
@@ -86,6 +144,7 @@ int main(int argc, char *argv[]) {
         app.get_formatter()->column_width(80);
         app.option_defaults()->always_capture_default();
         std::map<std::string, Model>                           ModelMap{{"sdual", Model::SDUAL}, {"lbit", Model::LBIT}};
+        std::map<std::string, Schedule>                        ScheduleMap{{"static", Schedule::STATIC}, {"dynamic", Schedule::DYNAMIC}};
         std::vector<std::pair<std::string, LogLevel>>          h5ppLevelMap{{"trace", LogLevel::trace}, {"debug", LogLevel::debug}, {"info", LogLevel::info}};
         std::vector<std::pair<std::string, level::level_enum>> SpdlogLevelMap{{"trace", level::trace}, {"debug", level::debug}, {"info", level::info}};
 
@@ -100,19 +159,37 @@ int main(int argc, char *argv[]) {
         app.add_flag  ("-l,--linkonly"    , link_only       , "Link only. Make the main file with external links to all the others");
         app.add_flag  ("-r,--replace"     , replace         , "Replace existing files");
         app.add_flag  ("-T,--usetemp"     , use_tmp         , "Use temp directory");
+        app.add_flag  ("--rescan"         , rescan          , "Ignore the manifest and rescan directories that have not changed");
+        app.add_flag  ("-w,--watch"       , watch           , "Keep running and merge new .h5 files as they are written");
+        app.add_option("--flushevery"     , flush_every     , "Seconds between flushing the databases to file in watch mode");
         app.add_option("--maxfiles"       , max_files       , "Maximum number of .h5 files to collect in each set");
         app.add_option("--maxdirs"        , max_dirs        , "Maximum number of simulation sets");
+        app.add_option("-j,--threads"     , num_threads     , "Number of threads used to crawl the source directories");
+        app.add_option("--schedule"       , schedule        , "Distribute directories over MPI ranks [static|dynamic]")->transform(CLI::CheckedTransformer(ScheduleMap, CLI::ignore_case));
+        app.add_option("--splitfiles"     , split_files     , "Split new directories with more .h5 files than this over several MPI ranks (0 = never)");
+        app.add_option("--prefetch"       , prefetch_files  , "Number of source files to read into memory ahead of merging (0 = off)");
+        app.add_option("--prefetchmb"     , prefetch_mb     , "Memory budget in MB for source files read ahead");
+        app.add_option("--readahead"      , readahead_max   , "Maximum number of upcoming source files to hint to the kernel for readahead (0 = off)");
+        app.add_option("--maxinflight"    , inflight_max    , "Maximum number of source files read ahead at the same time. Adapts to the filesystem latency");
+        app.add_option("--srcimagemb"     , src_image_mb    , "Read source files up to this size in MB into memory with one read before opening (0 = off)");
+        app.add_flag  ("--srcmmap"        , src_mmap        , "Open source files with a read-only mmap driver instead of sec2");
+        app.add_option("--stagedir"       , stage_dir       , "Copy upcoming source files to this local scratch directory before merging them (empty = off)")->excludes("--prefetch");
+        app.add_option("--stagemb"        , stage_mb        , "Disk budget in MB for source files copied to --stagedir, per MPI rank");
+        app.add_flag  ("!--no-srcprofile" , src_profile     , "Open source files with the default HDF5 settings instead of a small metadata cache, evict-on-close and no file locking");
+        app.add_flag  ("--crono2d"        , crono2d         , "Merge each crono table into one [iteration x seed] dataset instead of one table per iteration");
+        app.add_option("--validate"       , validate_procs  , "Number of processes that check the source files before merging (0 = off)");
         app.add_option("--maxseed"        , seed_max        , "Maximum seed number to collect");
         app.add_option("--minseed"        , seed_min        , "Minimum seed number to collect");
-        app.add_option("--inc"            , incfilter       , "Include paths to .h5 matching any in this list");
-        app.add_option("--exc"            , excfilter       , "Exclude paths to .h5 matching any in this list");
+        app.add_option("--inc"            , incfilter       , "Include paths to .h5 containing any of these globs");
+        app.add_option("--exc"            , excfilter       , "Exclude paths to .h5 containing any of these globs");
         app.add_option("-v,--log"         , verbosity       , "Log level")->transform(CLI::CheckedTransformer(h5ppLevelMap, CLI::ignore_case));
         app.add_option("-V,--logh5pp"     , verbosity_h5pp  , "Log level of h5pp")->transform(CLI::CheckedTransformer(h5ppLevelMap, CLI::ignore_case));
 
         CLI11_PARSE(app, argc, argv);
         /* clang-format on */
     }
-    tgt_dir = h5pp::fs::absolute(tgt_dir);
+    tgt_dir              = h5pp::fs::absolute(tgt_dir);
+    tools::h5io::crono2d = crono2d;
     for(auto &src_dir : src_dirs) {
         if(src_dir.is_relative()) {
             auto matching_dirs = tools::io::find_dir<false>(base_dir, src_dir.string(), src_out);
@@ -198,6 +275,10 @@ int main(int argc, char *argv[]) {
         tools::logger::log->info("Found source directory {}", src_dir.string());
     }
     if(tgt_dir.empty()) throw std::runtime_error("A target directory is required. Pass -t <dirpath>");
+    if(watch and use_tmp) throw std::runtime_error("Watch mode cannot be combined with a temp directory. Remove -T");
+    if(watch and link_only) throw std::runtime_error("Watch mode cannot be combined with link only. Remove -l");
+    if(split_files > 0 and max_files > 0) throw std::runtime_error("Splitting directories cannot be combined with --maxfiles");
+    if(split_files > 0 and use_tmp) throw std::runtime_error("Splitting directories cannot be combined with a temp directory. Remove -T");
 
     // Set file permissions
     auto perm = h5pp::FilePermission::READWRITE;
@@ -286,16 +367,295 @@ int main(int argc, char *argv[]) {
             default: throw std::runtime_error("Invalid model");
         }
 
-        // Open the target file
-        auto h5dirs = tools::io::find_h5_dirs(src_dirs, max_dirs, incfilter, excfilter);
+        // Define a new target h5file for the files in each h5dir
+        auto get_h5_tgt_path = [&](const h5pp::fs::path &h5dir) {
+            return h5pp::format("{}/{}.{}{}", tgt_dir.string(), h5pp::fs::path(tgt_path).stem().string(), tools::hash::std_hash(h5dir.string()),
+                                h5pp::fs::path(tgt_path).extension().string());
+        };
+
+        // Find the source directories and balance them across ranks by their estimated merge cost
+        auto h5dirs = tools::io::find_h5_dirs(src_dirs, max_dirs, incfilter, excfilter, num_threads);
+        auto get_h5_tgt_path_if_kept = [&](const h5pp::fs::path &h5dir) { return replace ? std::string() : get_h5_tgt_path(h5dir); };
+        switch(schedule) {
+            case Schedule::STATIC: tools::schedule::distribute_lpt(h5dirs, get_h5_tgt_path_if_kept, rescan, split_files, num_threads, verbosity_h5pp); break;
+            case Schedule::DYNAMIC: tools::schedule::sort_by_cost(h5dirs, get_h5_tgt_path_if_kept, rescan, split_files, num_threads, verbosity_h5pp); break;
+        }
+        // Slices of a split directory are merged into partial targets, which are reduced into the usual target afterwards.
+        // They live in a subdirectory, so that create_link_file does not pick them up.
+        auto get_h5_part_path = [&](const tools::schedule::Slice &slice) {
+            auto h5_tgt_path = h5pp::fs::path(get_h5_tgt_path(slice.h5dir));
+            return h5pp::format("{}/.partial/{}.part-{}-of-{}{}", tgt_dir.string(), h5_tgt_path.stem().string(), slice.index, slice.count,
+                                h5_tgt_path.extension().string());
+        };
         tools::logger::log->info("num h5dirs: {}", h5dirs.size());
+        std::optional<mpi::work_queue>       dir_queue; // Only used with the dynamic schedule
+        tools::io::concurrency               io_control(1, inflight_max); // Limits the reads ahead while the filesystem is slow
+        std::optional<tools::io::prefetcher> prefetch;  // Reads the source files of the current h5dir ahead of merge_file
+        std::optional<tools::io::readahead>  hints;     // Hints the kernel to read the next source files of the current h5dir
+        std::optional<tools::io::stager>     stage;     // Copies the source files of the current h5dir to the local disk ahead of merge_file
+        std::vector<std::byte>               src_image; // Reused buffer for source files read whole with --srcimagemb
+        std::unordered_set<std::string>      unfinished; // Source files of the current h5dir that validation found unfinished
         std::unordered_map<std::string, FileStats> file_stats;
         uintmax_t                                  srcBytes = 0; // Count the total size of scanned files
-        for(const auto &h5dir : h5dirs) {
-            // Define a new target h5file for the files in this h5dir
-            auto h5dir_hash  = tools::hash::std_hash(h5dir.string());
-            auto h5_tgt_path = h5pp::format("{}/{}.{}{}", tgt_dir.string(), h5pp::fs::path(tgt_path).stem().string(), tools::hash::std_hash(h5dir.string()),
-                                            h5pp::fs::path(tgt_path).extension().string());
+        auto load_tgtdb = [&keys](const h5pp::File &h5_tgt, tools::h5db::TgtDb &tgtdb) {
+            {
+                auto keepOpen = h5_tgt.getFileHandleToken();
+                tgtdb.file       = tools::h5db::loadFileDatabase(h5_tgt); // This database maps  src_name <--> FileId
+                tgtdb.quarantine = tools::h5db::loadQuarantine(h5_tgt);
+                tgtdb.dset       = tools::h5db::loadDatabase<h5pp::DsetInfo>(h5_tgt, keys.dsets);
+                tgtdb.table      = tools::h5db::loadDatabase<h5pp::TableInfo>(h5_tgt, keys.tables);
+                tgtdb.crono      = tools::h5db::loadDatabase<BufferedTableInfo>(h5_tgt, keys.cronos);
+                if(tools::h5io::crono2d) tgtdb.crono2d = tools::h5db::loadDatabase<h5pp::DsetInfo>(h5_tgt, keys.cronos);
+                tgtdb.scale      = tools::h5db::loadDatabase<BufferedTableInfo>(h5_tgt, keys.scales);
+                tgtdb.model      = tools::h5db::loadDatabase<h5pp::TableInfo>(h5_tgt, keys.models);
+            }
+            {
+                for(const auto &[infoKey, infoId] : tgtdb.table) infoId.info.assertReadReady();
+                for(const auto &[infoKey, infoId] : tgtdb.dset) infoId.info.assertReadReady();
+                //                for(const auto &[infoKey, infoId] : tgtdb.model) infoId.info.assertReadReady() ;
+                for(const auto &[infoKey, infoId] : tgtdb.crono) infoId.info.assertReadReady();
+                for(const auto &[infoKey, infoId] : tgtdb.crono2d) infoId.info.assertReadReady();
+                for(const auto &[infoKey, infoId] : tgtdb.scale) infoId.info.assertReadReady();
+            }
+        };
+        auto save_tgtdb = [](h5pp::File &h5_tgt, tools::h5db::TgtDb &tgtdb) {
+            tools::h5db::saveDatabase(h5_tgt, tgtdb.file);
+            tools::h5db::saveQuarantine(h5_tgt, tgtdb.quarantine);
+            tools::h5db::saveDatabase(h5_tgt, tgtdb.model);
+            tools::h5db::saveDatabase(h5_tgt, tgtdb.table);
+            tools::h5db::saveDatabase(h5_tgt, tgtdb.crono);
+            tools::h5db::saveDatabase(h5_tgt, tgtdb.crono2d);
+            tools::h5db::saveDatabase(h5_tgt, tgtdb.scale);
+            tools::h5db::saveDatabase(h5_tgt, tgtdb.dset);
+            tools::h5db::saveProgress(h5_tgt, tgtdb.progress);
+        };
+        // Returns the path of src_abs relative to the source directory it was found in
+        auto get_src_rel = [&](const h5pp::fs::path &src_abs) {
+            for(auto &src_can : src_dirs) {
+                auto [it1, it2] = std::mismatch(src_can.begin(), src_can.end(), src_abs.begin());
+                if(it1 == src_can.end()) return h5pp::fs::relative(src_abs, src_can);
+            }
+            throw std::runtime_error("Could not infer root src_dir from src_abs");
+        };
+        // Merges the source file src_abs into h5_tgt. Returns false when no more files should be merged from h5dir
+        // The size and mtime in src are cached from the directory listing, so the filesystem is not asked again here
+        auto merge_file = [&](const h5pp::fs::path &h5dir, const tools::io::FileEntry &src, size_t num_files, h5pp::File &h5_tgt, tools::h5db::TgtDb &tgtdb,
+                              bool &h5dir_complete) -> bool {
+            auto        t_src_item = tid::tic_scope("src_item");
+            const auto &src_abs    = src.path;
+            if(dir_queue) dir_queue->serve(); // Id 0 hands out directories between files, unless a thread of its own does that already
+            if(src_abs.extension() != ".h5") return true;
+
+            auto t_pre = tid::tic_scope("preamble");
+
+            // Check which source root this belongs to
+            auto src_rel  = get_src_rel(src_abs);
+            auto src_base = src_rel.parent_path();
+
+            bool stats_exists = file_stats.find(src_base) != file_stats.end();
+            if(not stats_exists) {
+                // Creeate new entry
+                file_stats[src_base].count = 0;
+                file_stats[src_base].files = num_files;
+            } else if(max_files > 0 and file_stats[src_base].count >= max_files) {
+                tools::logger::log->debug("Max files reached in {}: {}", src_base, file_stats[src_base].count);
+                return false;
+            }
+
+            // Append latest profiling information to table
+            t_pre.toc();
+
+            // We should now have enough to define a FileId
+            auto src_hash = tools::hash::hash_file_meta(src_abs, src.mtime);
+            auto src_seed = tools::parse::extract_digits_from_h5_filename<long>(src_rel.filename());
+            if(src_seed != std::clamp<long>(src_seed, seed_min, seed_max)) {
+                tools::logger::log->warn("Skipping seed {}: Valid are [{}-{}]", src_seed, seed_min, seed_max);
+                h5dir_complete = false;
+                return true;
+            }
+
+            FileId fileId(src_seed, src_abs.string(), src_hash);
+            // We check if it's in the file database. It is only entered there once it has been merged
+            auto status = tools::h5db::getFileIdStatus(tgtdb.file, fileId);
+
+            // Files that fail are quarantined until they change, so that later runs skip them without opening them
+            auto quarantine_file = [&](std::string_view reason) {
+                tgtdb.quarantine[fileId.path] = QuarantineId(fileId, reason);
+                h5dir_complete                = false;
+                return true;
+            };
+
+            // Update file stats
+            file_stats[src_base].elaps = file_stats[src_base].count == 0 ? t_src_item->restart_lap() : t_src_item->get_lap();
+            file_stats[src_base].count++;
+            file_stats[src_base].bytes += src.size;
+
+            // Print file status
+            srcBytes += src.size;
+
+            // The target size costs a stat, so we only ask for it when a line is actually printed
+            auto fmt_grp_bytes = tools::fmtBytes(true, file_stats[src_base].bytes, 1024, 1);
+            auto fmt_src_bytes = tools::fmtBytes(true, srcBytes, 1024, 1);
+            auto fmt_tgt_bytes = [&]() { return tools::fmtBytes(true, h5pp::fs::file_size(h5_tgt.getFilePath()), 1024, 1); };
+            auto fmt_spd_bytes = fmt::format("{:.1f} files", file_stats[src_base].get_speed());
+            if(tools::logger::log->level() <= 1) {
+                tools::logger::log->info(FMT_STRING("Found file: {} | {} | {} | count {} | src {} ({}) | tgt {} | {}/s"), src_rel.string(),
+                                         enum2str(status), src_hash, file_stats[src_base].count, fmt_grp_bytes, fmt_src_bytes, fmt_tgt_bytes(),
+                                         fmt_spd_bytes);
+            } else {
+                static size_t lastcount = 0;
+                if(file_stats[src_base].count < lastcount) lastcount = 0;
+                size_t filecounter = file_stats[src_base].count - lastcount;
+                if(t_h5mbl->get_lap() > 1.0 or file_stats[src_base].count % 1000 == 0 or file_stats[src_base].count == 1 or
+                   file_stats[src_base].count == file_stats[src_base].files) {
+                    tools::logger::log->info(FMT_STRING("Directory {} ({}) | count {} | src {} ({}) | tgt {} | {:.2f}/s | {}"), h5dir.string(),
+                                             file_stats[src_base].files, file_stats[src_base].count, fmt_grp_bytes, fmt_src_bytes, fmt_tgt_bytes(),
+                                             static_cast<double>(filecounter) / t_h5mbl->restart_lap(), io_control.summary());
+                    lastcount = file_stats[src_base].count;
+                }
+            }
+
+            if(status == FileIdStatus::UPTODATE) return true;
+            if(tools::h5db::isQuarantined(tgtdb.quarantine, fileId)) {
+                tools::logger::log->debug("Skipping quarantined file: {}", tgtdb.quarantine[fileId.path].string());
+                h5dir_complete = false;
+                return true;
+            }
+            if(unfinished.count(fileId.path) > 0) {
+                // Still running: not broken, so it is not quarantined, and the directory is scanned again on the next run
+                tools::logger::log->debug("Skipping unfinished file: {}", fileId.path);
+                h5dir_complete = false;
+                return true;
+            }
+
+            // If we've reached this point we will start reading from h5_src many times.
+            if(hints) hints->advance(src_abs);
+            // Small files are read whole with one sequential read, so that HDF5 does its many small reads in memory instead of on disk.
+            auto                    image      = prefetch ? prefetch->take(src_abs) : std::nullopt;
+            std::vector<std::byte> *image_data = image and image->ok ? &image->data : nullptr;
+            auto                    staged     = stage ? stage->take(src_abs) : std::nullopt;
+            const h5pp::fs::path   *local      = staged and staged->ok ? &staged->path : nullptr;
+            if(image_data == nullptr and local == nullptr and src_image_mb > 0 and src.size <= src_image_mb * 1024 * 1024) {
+                auto t_read = tid::tic_scope("read_image");
+                if(tools::io::read_file(src_abs, src_image, src.size)) {
+                    image_data = &src_image;
+                    t_read.toc();
+                    io_control.report(tools::io::concurrency::op::read, t_read->get_last_interval(), src_image.size());
+                } else {
+                    tools::logger::log->debug("Could not read {} into memory: opening it with sec2", src_abs.string());
+                }
+            }
+            // Time the open and the merge under the driver used, to compare them in the tid tree
+            auto       t_driver = tid::tic_scope(image_data != nullptr ? "src_image" : (local != nullptr ? "src_stage" : (src_mmap ? "src_mmap" : "src_sec2")));
+            auto       t_open   = tid::tic_scope("open");
+            h5pp::File h5_src;
+            std::optional<decltype(h5_src.getFileHandleToken())> srcKeepOpen; // Open once for the checks and the merge below
+            tools::h5io::LinkIndex                               srcIndex;    // All the objects in h5_src, to find them without asking HDF5 again
+            try {
+                h5_src = h5pp::File(src_abs.string(), h5pp::FilePermission::READONLY, verbosity_h5pp);
+                if(image_data != nullptr) {
+                    // Open the copy in memory instead of the file on disk. The core driver refuses images of files that exist on disk.
+                    // The image is not copied, so image and src_image must outlive h5_src, which is declared after them.
+                    if(tools::h5vfd::set_fapl_image(h5_src.plists.fileAccess, image_data->data(), image_data->size()) < 0)
+                        throw std::runtime_error("Could not set the file image driver");
+                } else if(local != nullptr) {
+                    // Map the local copy, but keep the name of the source file: the databases and model parameters are keyed on its path
+                    if(tools::h5vfd::set_fapl_redirect(h5_src.plists.fileAccess, local->c_str()) < 0)
+                        throw std::runtime_error("Could not set the mmap driver for the staged file");
+                } else if(src_mmap) {
+                    if(tools::h5vfd::set_fapl_mmap(h5_src.plists.fileAccess) < 0) throw std::runtime_error("Could not set the mmap driver");
+                }
+                if(src_profile) tools::h5io::setSourceProfile(h5_src.plists.fileAccess);
+                // h5_src.setDriver_core(false, 10 * 1024 * 1024);
+                // h5_src.setDriver_sec2();
+                //                 h5_src.setDriver_core();
+                // H5Pset_cache(h5_src.plists.fileAccess, 1000, 7919,rdcc_nbytes, 0.0 );
+                h5_src.setCloseDegree(H5F_close_degree_t::H5F_CLOSE_WEAK); // Delay closing ids related to this file.
+                srcKeepOpen.emplace(h5_src.getFileHandleToken());
+                srcIndex = tools::h5io::LinkIndex(h5_src);
+            } catch(const std::exception &ex) {
+                tools::logger::log->warn("Skipping broken file: {}\n\tReason: {}\n", src_abs.string(), ex.what());
+                return quarantine_file(ex.what());
+            }
+            try {
+                if(not srcIndex.is_dataset("common/finished_all")) {
+                    tools::logger::log->warn("Skipping broken file: {}\n\tReason: Could not find dataset [common/finished_all]", src_abs.string());
+                    return quarantine_file("Could not find dataset [common/finished_all]");
+                }
+                if(finished and not h5_src.readDataset<bool>("common/finished_all")) {
+                    // Not quarantined: the simulation may still be running, and the file changes when it finishes
+                    tools::logger::log->warn("Skipping file: {}\n\tReason: Simulation has not finished", src_abs.string());
+                    h5dir_complete = false;
+                    return true;
+                }
+            } catch(const std::exception &ex) {
+                tools::logger::log->warn("Skipping file: {}\n\tReason: {}", src_abs.string(), ex.what());
+                return quarantine_file(ex.what());
+            }
+
+            t_open.toc();
+            if(hints) hints->report_open(t_open->get_last_interval());
+            if(image_data == nullptr) io_control.report(tools::io::concurrency::op::open, t_open->get_last_interval(), src.size);
+
+            {
+                auto tgtKeepOpen = h5_tgt.getFileHandleToken();
+                switch(model) {
+                    case Model::SDUAL: {
+                        tools::h5io::merge<sdual>(h5_tgt, h5_src, srcIndex, fileId, file_stats[src_base], keys, tgtdb);
+                        break;
+                    }
+                    case Model::LBIT: {
+                        tools::h5io::merge<lbit>(h5_tgt, h5_src, srcIndex, fileId, file_stats[src_base], keys, tgtdb);
+                        break;
+                    }
+                }
+            }
+            {
+                auto t_close = tid::tic_scope("close"); // Closing the last id flushes the metadata cache of the source file
+                srcKeepOpen.reset();
+            }
+            if(staged) stage->release(staged.value());
+            tgtdb.file[fileId.path] = fileId;
+            tgtdb.quarantine.erase(fileId.path);
+            tools::logger::log->debug("mem[rss {:<.2f}|peak {:<.2f}|vm {:<.2f}]MB | file db size {}", tools::prof::mem_rss_in_mb(),
+                                      tools::prof::mem_hwm_in_mb(), tools::prof::mem_vm_in_mb(), tgtdb.file.size());
+            return true;
+        };
+        // Merges all the files in h5dir into its own target file. A slice of h5dir is merged into a new partial target instead
+        auto merge_dir = [&](const h5pp::fs::path &h5unit) {
+            auto slice       = tools::schedule::parse_slice_path(h5unit);
+            auto h5dir       = slice.h5dir;
+            auto h5_tgt_path = slice.is_split() ? get_h5_part_path(slice) : get_h5_tgt_path(h5dir);
+
+            // Collect all the .h5 files in h5dir, sorted, with their sizes and mtimes
+            auto h5files = tools::io::list_h5_files(h5dir);
+
+            // The manifest describes the whole directory, also when only a slice of it is merged here
+            auto manifestId = tools::h5db::getManifestId(h5dir, h5files);
+            if(slice.is_split()) {
+                auto outside = [&slice](const tools::io::FileEntry &src) {
+                    return not slice.contains(tools::parse::extract_digits_from_h5_filename<long>(src.path.filename()));
+                };
+                h5files.erase(std::remove_if(h5files.begin(), h5files.end(), outside), h5files.end());
+                file_stats.erase(get_src_rel(h5dir).string()); // Count files (and crono indices) from zero in each partial target
+                h5pp::fs::create_directories(h5pp::fs::path(h5_tgt_path).parent_path());
+                tools::logger::log->info("Merging slice {} of {} with seeds [{}, {}]", slice.index, slice.count, slice.seed_min, slice.seed_max);
+            }
+            tools::logger::log->info("num h5files: {}", h5files.size());
+
+            // Skip this directory if nothing has changed since it was last merged completely
+            if(not slice.is_split() and not replace and not rescan and h5pp::fs::exists(h5_tgt_path)) {
+                std::optional<ManifestId> oldManifestId;
+                try {
+                    auto h5_old   = h5pp::File(h5_tgt_path, h5pp::FilePermission::READONLY, verbosity_h5pp);
+                    oldManifestId = tools::h5db::loadManifest(h5_old);
+                } catch(const std::exception &ex) { tools::logger::log->warn("Could not read manifest in [{}]: {}", h5_tgt_path, ex.what()); }
+                if(oldManifestId and oldManifestId.value() == manifestId) {
+                    tools::logger::log->info("Skipping unchanged directory: {}", manifestId.string());
+                    return;
+                }
+            }
+            bool h5dir_complete = max_files == 0; // Becomes false if any file in h5dir is left unmerged
 
             // Initialize file
             //        auto plists = h5pp::defaultPlists;
@@ -308,7 +668,7 @@ int main(int argc, char *argv[]) {
             auto h5_tgt = h5pp::File();
 
             try {
-                h5_tgt = h5pp::File(h5_tgt_path, perm, verbosity_h5pp);
+                h5_tgt = h5pp::File(h5_tgt_path, slice.is_split() ? h5pp::FilePermission::REPLACE : perm, verbosity_h5pp);
 
             } catch(const std::exception &ex) {
                 H5Eprint(H5E_DEFAULT, stderr);
@@ -349,175 +709,73 @@ int main(int argc, char *argv[]) {
             // Load database
             tools::h5db::TgtDb tgtdb;
             //    h5_tgt.setDriver_core();
-            {
-                auto keepOpen = h5_tgt.getFileHandleToken();
-                tgtdb.file    = tools::h5db::loadFileDatabase(h5_tgt); // This database maps  src_name <--> FileId
-                tgtdb.dset    = tools::h5db::loadDatabase<h5pp::DsetInfo>(h5_tgt, keys.dsets);
-                tgtdb.table   = tools::h5db::loadDatabase<h5pp::TableInfo>(h5_tgt, keys.tables);
-                tgtdb.crono   = tools::h5db::loadDatabase<BufferedTableInfo>(h5_tgt, keys.cronos);
-                tgtdb.scale   = tools::h5db::loadDatabase<BufferedTableInfo>(h5_tgt, keys.scales);
-                tgtdb.model   = tools::h5db::loadDatabase<h5pp::TableInfo>(h5_tgt, keys.models);
-            }
-            {
-                for(const auto &[infoKey, infoId] : tgtdb.table) infoId.info.assertReadReady();
-                for(const auto &[infoKey, infoId] : tgtdb.dset) infoId.info.assertReadReady();
-                //                for(const auto &[infoKey, infoId] : tgtdb.model) infoId.info.assertReadReady() ;
-                for(const auto &[infoKey, infoId] : tgtdb.crono) infoId.info.assertReadReady();
-                for(const auto &[infoKey, infoId] : tgtdb.scale) infoId.info.assertReadReady();
-            }
-            uintmax_t tgtBytes = h5pp::fs::file_size(h5_tgt.getFilePath());
-
-            // Collect and sort all the files in h5dir
-            using h5iter = h5pp::fs::directory_iterator;
-            std::vector<h5pp::fs::path> h5files;
-            copy(h5iter(h5dir), h5iter(), back_inserter(h5files));
-            std::sort(h5files.begin(), h5files.end());
-            tools::logger::log->info("num h5files: {}", h5files.size());
-            // No barriers from now on: There can be a different number of files in h5files!
-            for(const auto &src_item : h5files) {
-                auto        t_src_item = tid::tic_scope("src_item");
-                const auto &src_abs    = src_item;
-                if(not h5pp::fs::is_regular_file(src_abs)) continue;
-                if(src_abs.extension() != ".h5") continue;
-
-                auto t_pre = tid::tic_scope("preamble");
-
-                // Check which source root this belongs to
-                // TODO: What does this do? Expand comment
-                h5pp::fs::path src_dir;
-                for(auto &src_can : src_dirs) {
-                    auto [it1, it2] = std::mismatch(src_can.begin(), src_can.end(), src_abs.begin());
-                    if(it1 == src_can.end()) {
-                        src_dir = src_can;
-                        break;
-                    }
+            load_tgtdb(h5_tgt, tgtdb);
+
+            // Only validate or read ahead the files that merge_file will open: the others are skipped on their cached size and mtime
+            std::vector<tools::io::FileEntry> upcoming;
+            std::vector<FileId>               upcomingIds;
+            if(prefetch_files > 0 or validate_procs > 0 or readahead_max > 0 or not stage_dir.empty()) {
+                for(const auto &src : h5files) {
+                    auto src_seed = tools::parse::extract_digits_from_h5_filename<long>(src.path.filename());
+                    if(src_seed != std::clamp<long>(src_seed, seed_min, seed_max)) continue;
+                    FileId fileId(src_seed, src.path.string(), tools::hash::hash_file_meta(src.path, src.mtime));
+                    if(tools::h5db::getFileIdStatus(tgtdb.file, fileId) == FileIdStatus::UPTODATE) continue;
+                    if(tools::h5db::isQuarantined(tgtdb.quarantine, fileId)) continue;
+                    upcoming.emplace_back(src);
+                    upcomingIds.emplace_back(fileId);
                 }
-                if(src_dir.empty()) throw std::runtime_error("Could not infer root src_dir from src_abs");
-
-                auto src_rel  = h5pp::fs::relative(src_abs, src_dir);
-                auto src_base = src_rel.parent_path();
-
-                bool stats_exists = file_stats.find(src_base) != file_stats.end();
-                if(not stats_exists) {
-                    // Creeate new entry
-                    file_stats[src_base].count = 0;
-                    file_stats[src_base].files = h5files.size();
-                } else if(max_files > 0 and file_stats[src_base].count >= max_files) {
-                    tools::logger::log->debug("Max files reached in {}: {}", src_base, file_stats[src_base].count);
-                    break;
-                }
-
-                // Append latest profiling information to table
-                t_pre.toc();
-
-                // We should now have enough to define a FileId
-                auto src_hash = tools::hash::hash_file_meta(src_abs);
-                auto src_seed = tools::parse::extract_digits_from_h5_filename<long>(src_rel.filename());
-                if(src_seed != std::clamp<long>(src_seed, seed_min, seed_max)) {
-                    tools::logger::log->warn("Skipping seed {}: Valid are [{}-{}]", src_seed, seed_min, seed_max);
-                    continue;
-                }
-
-                FileId fileId(src_seed, src_abs.string(), src_hash);
-                // We check if it's in the file database
-                auto status             = tools::h5db::getFileIdStatus(tgtdb.file, fileId);
-                tgtdb.file[fileId.path] = fileId;
-
-                // Update file stats
-                file_stats[src_base].elaps = file_stats[src_base].count == 0 ? t_src_item->restart_lap() : t_src_item->get_lap();
-                file_stats[src_base].count++;
-                file_stats[src_base].bytes += h5pp::fs::file_size(src_abs.string());
-
-                // Print file status
-                srcBytes += h5pp::fs::file_size(src_abs.string());
-                tgtBytes = h5pp::fs::file_size(h5_tgt.getFilePath());
-                tgtBytes = h5pp::fs::file_size(h5_tgt.getFilePath());
-
-                auto fmt_grp_bytes = tools::fmtBytes(true, file_stats[src_base].bytes, 1024, 1);
-                auto fmt_src_bytes = tools::fmtBytes(true, srcBytes, 1024, 1);
-                auto fmt_tgt_bytes = tools::fmtBytes(true, tgtBytes, 1024, 1);
-                auto fmt_spd_bytes = fmt::format("{:.1f} files", file_stats[src_base].get_speed());
-                if(tools::logger::log->level() <= 1) {
-                    tools::logger::log->info(FMT_STRING("Found file: {} | {} | {} | count {} | src {} ({}) | tgt {} | {}/s"), src_rel.string(),
-                                             enum2str(status), src_hash, file_stats[src_base].count, fmt_grp_bytes, fmt_src_bytes, fmt_tgt_bytes,
-                                             fmt_spd_bytes);
-                } else {
-                    static size_t lastcount = 0;
-                    if(file_stats[src_base].count < lastcount) lastcount = 0;
-                    size_t filecounter = file_stats[src_base].count - lastcount;
-                    if(t_h5mbl->get_lap() > 1.0 or file_stats[src_base].count % 1000 == 0 or file_stats[src_base].count == 1 or
-                       file_stats[src_base].count == file_stats[src_base].files) {
-                        tools::logger::log->info(FMT_STRING("Directory {} ({}) | count {} | src {} ({}) | tgt {} | {:.2f}/s"), h5dir.string(),
-                                                 file_stats[src_base].files, file_stats[src_base].count, fmt_grp_bytes, fmt_src_bytes, fmt_tgt_bytes,
-                                                 static_cast<double>(filecounter) / t_h5mbl->restart_lap());
-                        lastcount = file_stats[src_base].count;
-                    }
-                }
-
-                if(status == FileIdStatus::UPTODATE) continue;
-
-                // If we've reached this point we will start reading from h5_src many times.
-                auto       t_open = tid::tic_scope("open");
-                h5pp::File h5_src;
-                try {
-                    h5_src = h5pp::File(src_abs.string(), h5pp::FilePermission::READONLY, verbosity_h5pp);
-                    // h5_src.setDriver_core(false, 10 * 1024 * 1024);
-                    // h5_src.setDriver_sec2();
-                    //                 h5_src.setDriver_core();
-                    // H5Pset_cache(h5_src.plists.fileAccess, 1000, 7919,rdcc_nbytes, 0.0 );
-                    h5_src.setCloseDegree(H5F_close_degree_t::H5F_CLOSE_WEAK); // Delay closing ids related to this file.
-
-                } catch(const std::exception &ex) {
-                    tools::logger::log->warn("Skipping broken file: {}\n\tReason: {}\n", src_abs.string(), ex.what());
-                    continue;
-                }
-                try {
-                    if(not h5_src.linkExists("common/finished_all")) {
-                        tools::logger::log->warn("Skipping broken file: {}\n\tReason: Could not find dataset [common/finished_all]", src_abs.string());
-                        continue;
-                    }
-                    if(finished and not h5_src.readDataset<bool>("common/finished_all")) {
-                        tools::logger::log->warn("Skipping file: {}\n\tReason: Simulation has not finished", src_abs.string());
+            }
+            if(validate_procs > 0) {
+                // Files that fail the checks are quarantined, so merge_file skips them without opening them.
+                // Unfinished files are only skipped in this run: they are not broken, just still being written.
+                auto validity = tools::validate::check_files(upcoming, keys.get_algos(), finished, validate_procs);
+                std::vector<tools::io::FileEntry> valid;
+                for(size_t i = 0; i < upcoming.size(); i++) {
+                    if(validity[i] == tools::validate::Validity::OK or validity[i] == tools::validate::Validity::UNKNOWN) {
+                        valid.emplace_back(upcoming[i]);
                         continue;
                     }
-                } catch(const std::exception &ex) {
-                    tools::logger::log->warn("Skipping file: {}\n\tReason: {}", src_abs.string(), ex.what());
-                    continue;
+                    auto reason = tools::validate::reason(validity[i]);
+                    tools::logger::log->warn("Skipping file: {}\n\tReason: {}", upcoming[i].path.string(), reason);
+                    if(validity[i] == tools::validate::Validity::NOT_FINISHED)
+                        unfinished.insert(upcomingIds[i].path);
+                    else
+                        tgtdb.quarantine[upcomingIds[i].path] = QuarantineId(upcomingIds[i], reason);
                 }
+                tools::logger::log->info("Validated {} files: {} left to merge", upcoming.size(), valid.size());
+                upcoming = std::move(valid);
+            }
+            if(readahead_max > 0) hints.emplace(upcoming, readahead_max, &io_control);
+            // Both take upcoming: the command line does not allow --prefetch with --stagedir
+            if(prefetch_files > 0) {
+                prefetch.emplace(std::move(upcoming), prefetch_files, prefetch_mb * 1024 * 1024, &io_control);
+            } else if(not stage_dir.empty()) {
+                // One directory per rank: ranks on the same node share the local disk
+                auto stage_sub = stage_dir / fmt::format("{}.{}", tools::h5io::get_tmp_dirname(argv[0]), mpi::world.id);
+                stage.emplace(std::move(upcoming), stage_sub, stage_mb * 1024 * 1024, &io_control);
+            }
 
-                t_open.toc();
-
-                {
-                    auto tgtKeepOpen = h5_tgt.getFileHandleToken();
-                    auto srcKeepOpen = h5_src.getFileHandleToken();
-                    switch(model) {
-                        case Model::SDUAL: {
-                            tools::h5io::merge<sdual>(h5_tgt, h5_src, fileId, file_stats[src_base], keys, tgtdb);
-                            break;
-                        }
-                        case Model::LBIT: {
-                            tools::h5io::merge<lbit>(h5_tgt, h5_src, fileId, file_stats[src_base], keys, tgtdb);
-                            break;
-                        }
-                    }
-                }
-                tools::logger::log->debug("mem[rss {:<.2f}|peak {:<.2f}|vm {:<.2f}]MB | file db size {}", tools::prof::mem_rss_in_mb(),
-                                          tools::prof::mem_hwm_in_mb(), tools::prof::mem_vm_in_mb(), tgtdb.file.size());
+            // No barriers from now on: There can be a different number of files in h5files!
+            for(const auto &src : h5files) {
+                if(not merge_file(h5dir, src, h5files.size(), h5_tgt, tgtdb, h5dir_complete)) break;
             }
+            prefetch.reset();
+            hints.reset();
+            stage.reset();
+            unfinished.clear();
 
-            tools::h5db::saveDatabase(h5_tgt, tgtdb.file);
-            tools::h5db::saveDatabase(h5_tgt, tgtdb.model);
-            tools::h5db::saveDatabase(h5_tgt, tgtdb.table);
-            tools::h5db::saveDatabase(h5_tgt, tgtdb.crono);
-            tools::h5db::saveDatabase(h5_tgt, tgtdb.scale);
-            tools::h5db::saveDatabase(h5_tgt, tgtdb.dset);
+            save_tgtdb(h5_tgt, tgtdb);
+            if(h5dir_complete) tools::h5db::saveManifest(h5_tgt, manifestId);
 
             tgtdb.file.clear();
+            tgtdb.quarantine.clear();
             tgtdb.model.clear();
             tgtdb.table.clear();
             tgtdb.crono.clear();
+            tgtdb.crono2d.clear();
             tgtdb.scale.clear();
             tgtdb.dset.clear();
+            tgtdb.progress.clear();
 
             // TODO: Put the lines below in a "at quick exit" function
             tools::h5io::writeProfiling(h5_tgt);
@@ -531,40 +789,139 @@ int main(int argc, char *argv[]) {
 
             tools::logger::log->info("Results written to file {}", h5_tgt_path);
             tools::h5dbg::assert_no_dangling_ids(h5_tgt, __FUNCTION__, __LINE__); // Check that there are no open HDF5 handles
+        };
+
+        if(schedule == Schedule::DYNAMIC) {
+            // Every rank asks id 0 for a new directory when it is done with the previous one
+            dir_queue.emplace(h5dirs, 0);
+            h5dirs.clear(); // From now on this is the list of directories merged on this rank
+            while(auto h5dir = dir_queue->next()) {
+                merge_dir(h5dir.value());
+                h5dirs.emplace_back(h5dir.value());
+            }
+            dir_queue->finish();
+            dir_queue.reset();
+        } else {
+            for(const auto &h5dir : h5dirs) merge_dir(h5dir);
         }
-    }
 
-    mpi::barrier();
-
-    // Now id 1 can merge the files into one final file
-    if(mpi::world.id == 0) {
-        tools::logger::log->info("Creating main file for external links: {}", tgt_path);
-        auto h5_tgt   = h5pp::File(tgt_path, h5pp::FilePermission::REPLACE, verbosity_h5pp);
-        auto tgt_stem = h5pp::fs::path(tgt_file).stem().string();
-        auto tgt_algo = model == Model::LBIT ? "fLBIT" : "xDMRG";
-        for(const auto &obj : h5pp::fs::directory_iterator(tgt_dir, h5pp::fs::directory_options::follow_directory_symlink)) {
-            if(obj.is_regular_file() and obj.path().extension() == ".h5") {
-                if(obj.path().filename() != tgt_file and obj.path().stem().string().find(tgt_stem) != std::string::npos) {
-                    // Found a file that we can link!
-                    auto h5_ext = h5pp::File(obj.path().string(), h5pp::FilePermission::READONLY, verbosity_h5pp);
-                    // Find the path to the algorithm in this external file
-                    auto algo_group = h5_ext.findGroups(tgt_algo, "/", 1);
-                    if(algo_group.empty()) {
-                        tools::logger::log->error("Could not find algo group {} in external file {}: [{}]", tgt_algo, obj.path().string(), algo_group);
-                        continue;
-                        //                        throw std::runtime_error(
-                        //                            h5pp::format("Could not find algo group {} in external file {}: [{}]", tgt_algo, obj.path().string(),
-                        //                            algo_group));
+        // Reduce the partial targets of each split directory pairwise, in rounds, spread over all ranks
+        std::vector<std::string> h5units(h5dirs.begin(), h5dirs.end());
+        mpi::allgatherv(h5units);
+        std::map<h5pp::fs::path, size_t> num_slices;
+        for(const auto &h5unit : h5units) {
+            auto slice = tools::schedule::parse_slice_path(h5unit);
+            if(slice.is_split()) num_slices[slice.h5dir] = slice.count;
+        }
+        if(not num_slices.empty()) {
+            auto t_reduce = tid::tic_scope("reduce");
+            for(size_t stride = 1; std::any_of(num_slices.begin(), num_slices.end(), [&](const auto &n) { return stride < n.second; }); stride *= 2) {
+                size_t task = 0;
+                for(const auto &[h5dir, count] : num_slices) {
+                    for(size_t index = 0; index + stride < count; index += 2 * stride) {
+                        if(task++ % mpi::world.get_size<size_t>() != mpi::world.get_id<size_t>()) continue;
+                        auto               part_a = get_h5_part_path({h5dir, index, count});
+                        auto               part_b = get_h5_part_path({h5dir, index + stride, count});
+                        auto               h5_a   = h5pp::File(part_a, h5pp::FilePermission::READWRITE, verbosity_h5pp);
+                        auto               h5_b   = h5pp::File(part_b, h5pp::FilePermission::READONLY, verbosity_h5pp);
+                        tools::h5db::TgtDb tgtdb, partdb;
+                        h5_a.setCompressionLevel(2);
+                        load_tgtdb(h5_a, tgtdb);
+                        load_tgtdb(h5_b, partdb);
+                        tools::h5io::mergePartial(h5_a, tgtdb, h5_b, partdb, keys);
+                        save_tgtdb(h5_a, tgtdb);
+                        tgtdb.clear();
+                        partdb.clear();
+                        h5_a.flush();
+                        h5_b = h5pp::File();
+                        h5pp::fs::remove(part_b);
                     }
+                }
+                mpi::barrier();
+            }
+            size_t task = 0;
+            for(const auto &[h5dir, count] : num_slices) {
+                if(task++ % mpi::world.get_size<size_t>() != mpi::world.get_id<size_t>()) continue;
+                auto h5_tgt_path = get_h5_tgt_path(h5dir);
+                tools::logger::log->info("Results written to file {}", h5_tgt_path);
+                h5pp::fs::rename(get_h5_part_path({h5dir, 0, count}), h5_tgt_path);
+            }
+            mpi::barrier();
+        }
 
-                    auto tgt_link = h5pp::fs::proximate(obj.path(), tgt_dir);
-                    tools::logger::log->info("Creating external link: {} -> {}", algo_group[0], tgt_link.string());
-                    h5_tgt.createExternalLink(tgt_link.string(), algo_group[0], algo_group[0]);
+        if(watch) {
+            // Make the main file now, since the targets stay open (and locked) while watching
+            mpi::barrier();
+            if(mpi::world.id == 0) create_link_file(tgt_dir, tgt_file, model, verbosity_h5pp);
+
+            // Keep the targets, their databases and the source metadata resident, and merge new files as they are closed
+            struct WatchTarget {
+                h5pp::File         h5_tgt;
+                tools::h5db::TgtDb tgtdb;
+                bool               complete = true;
+            };
+            tools::h5io::keep_srcdb = true;
+            std::map<h5pp::fs::path, WatchTarget> targets;
+            tools::watch::inotify                  watcher;
+            for(const auto &h5unit : h5dirs) {
+                auto slice = tools::schedule::parse_slice_path(h5unit);
+                if(slice.index != 0) continue; // Only one rank watches a split directory
+                auto &h5dir   = slice.h5dir;
+                auto &target  = targets[h5dir];
+                target.h5_tgt = h5pp::File(get_h5_tgt_path(h5dir), h5pp::FilePermission::READWRITE, verbosity_h5pp);
+                target.h5_tgt.setCompressionLevel(2);
+                load_tgtdb(target.h5_tgt, target.tgtdb);
+                watcher.add(h5dir);
+            }
+            tools::watch::register_stop_signals();
+            tools::logger::log->info("Watching {} directories for new files", targets.size());
+
+            auto flush_targets = [&]() {
+                auto t_flush = tid::tic_scope("flush");
+                for(auto &[h5dir, target] : targets) {
+                    for(auto &[infoKey, infoId] : target.tgtdb.crono) infoId.buff.flush();
+                    for(auto &[infoKey, infoId] : target.tgtdb.scale) infoId.buff.flush();
+                    save_tgtdb(target.h5_tgt, target.tgtdb);
+                    target.h5_tgt.flush();
+                }
+            };
+
+            auto t_watch = tid::tic_scope("watch");
+            while(not tools::watch::stop_requested()) {
+                for(const auto &src_abs : watcher.read(1000)) {
+                    auto src = tools::io::stat_file(src_abs);
+                    if(not src) continue; // Removed again, or not a regular file
+                    auto &target = targets.at(src_abs.parent_path());
+                    try {
+                        merge_file(src_abs.parent_path(), src.value(), target.tgtdb.file.size() + 1, target.h5_tgt, target.tgtdb, target.complete);
+                    } catch(const std::exception &ex) {
+                        // One bad file must not stop the watch: quarantine it until it changes, like the files that fail to open
+                        tools::logger::log->error("Skipping file: {}\n\tReason: {}", src_abs.string(), ex.what());
+                        target.complete = false;
+                        try {
+                            auto   src_seed = tools::parse::extract_digits_from_h5_filename<long>(src_abs.filename());
+                            FileId fileId(src_seed, src_abs.string(), tools::hash::hash_file_meta(src_abs, src->mtime));
+                            target.tgtdb.quarantine[fileId.path] = QuarantineId(fileId, ex.what());
+                        } catch(const std::exception &err) { tools::logger::log->warn("Could not quarantine {}: {}", src_abs.string(), err.what()); }
+                    }
+                }
+                if(t_watch->get_lap() > flush_every) {
+                    flush_targets();
+                    t_watch->start_lap();
                 }
             }
+            tools::logger::log->info("Stopped watching: saving databases");
+            flush_targets();
+            for(auto &[h5dir, target] : targets) tools::h5io::writeProfiling(target.h5_tgt);
+            targets.clear();
         }
     }
 
+    mpi::barrier();
+
+    // Now id 0 can merge the files into one final file. In watch mode it was made before watching
+    if(mpi::world.id == 0 and not watch) create_link_file(tgt_dir, tgt_file, model, verbosity_h5pp);
+
     mpi::barrier();
     mpi::finalize();
     return 0;
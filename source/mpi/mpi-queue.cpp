@@ -0,0 +1,117 @@
+#include "mpi-queue.h"
+#include "mpi-tools.h"
+#include <io/logger.h>
+#include <tid/tid.h>
+
+mpi::work_queue::work_queue(const std::vector<h5pp::fs::path> &paths_, int master_) : master(master_) {
+    if(world.id == master) {
+        paths = std::deque<h5pp::fs::path>(paths_.begin(), paths_.end());
+        post_request();
+        if(world.size > 1 and thread_level >= MPI_THREAD_SERIALIZED) {
+            server = std::thread([this]() {
+                while(not stopping) {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        serve_unlocked(false);
+                        if(request == MPI_REQUEST_NULL) break; // Every worker has been told to stop
+                    }
+                    std::this_thread::sleep_for(serve_interval);
+                }
+            });
+        }
+    }
+}
+
+mpi::work_queue::~work_queue() {
+    // Normally finish() has already emptied everything. Otherwise we are unwinding, and can at least let go of our own requests
+    stop_server();
+    if(request != MPI_REQUEST_NULL) {
+        MPI_Cancel(&request);
+        MPI_Request_free(&request);
+    }
+    for(auto &[msg, req] : replies) MPI_Request_free(&req);
+}
+
+void mpi::work_queue::post_request() {
+    if(num_stopped < world.size - 1) MPI_Irecv(&request_buf, 1, MPI_INT, MPI_ANY_SOURCE, tag_request, MPI_COMM_WORLD, &request);
+}
+
+void mpi::work_queue::reply(int dst) {
+    auto &[msg, req] = replies.emplace_back();
+    if(not paths.empty()) {
+        msg = paths.front().string();
+        paths.pop_front();
+        tools::logger::log->debug("Sending {} to id {} | {} left", msg, dst, paths.size());
+    } else {
+        num_stopped++;
+    }
+    MPI_Isend(msg.data(), static_cast<int>(msg.size()), MPI_CHAR, dst, tag_reply, MPI_COMM_WORLD, &req);
+}
+
+void mpi::work_queue::stop_server() {
+    stopping = true;
+    if(server.joinable()) server.join();
+}
+
+void mpi::work_queue::serve(bool wait) {
+    if(world.id != master) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    serve_unlocked(wait);
+}
+
+void mpi::work_queue::serve_unlocked(bool wait) {
+    while(request != MPI_REQUEST_NULL) {
+        int        flag = 0;
+        MPI_Status status;
+        if(wait) {
+            MPI_Wait(&request, &status);
+            flag = 1;
+        } else {
+            MPI_Test(&request, &flag, &status);
+        }
+        if(flag == 0) break;
+        reply(status.MPI_SOURCE);
+        post_request();
+    }
+    // Let go of the replies that have been delivered
+    replies.remove_if([wait](auto &r) {
+        int flag = 1;
+        if(wait)
+            MPI_Wait(&r.second, MPI_STATUS_IGNORE);
+        else
+            MPI_Test(&r.second, &flag, MPI_STATUS_IGNORE);
+        return flag != 0;
+    });
+}
+
+std::optional<h5pp::fs::path> mpi::work_queue::next() {
+    auto t_next = tid::tic_scope("next");
+    if(world.id == master) {
+        std::lock_guard<std::mutex> lock(mutex);
+        serve_unlocked(false);
+        if(paths.empty()) return std::nullopt;
+        auto path = paths.front();
+        paths.pop_front();
+        return path;
+    }
+    // Ask the master for more work, and wait for the answer
+    int         dummy = 0;
+    MPI_Request req   = MPI_REQUEST_NULL;
+    MPI_Isend(&dummy, 1, MPI_INT, master, tag_request, MPI_COMM_WORLD, &req);
+    MPI_Status status;
+    MPI_Probe(master, tag_reply, MPI_COMM_WORLD, &status);
+    int count = 0;
+    MPI_Get_count(&status, MPI_CHAR, &count);
+    std::string msg(static_cast<size_t>(count), '\0');
+    MPI_Recv(msg.data(), count, MPI_CHAR, master, tag_reply, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    MPI_Wait(&req, MPI_STATUS_IGNORE);
+    if(msg.empty()) return std::nullopt;
+    return h5pp::fs::path(msg);
+}
+
+void mpi::work_queue::finish() {
+    if(world.id != master) return;
+    auto t_finish = tid::tic_scope("finish");
+    stop_server();
+    serve(true);
+}
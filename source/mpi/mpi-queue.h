@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <h5pp/details/h5ppFilesystem.h>
+#include <list>
+#include <mpi.h>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mpi {
+    /*! \brief Dynamic master/worker queue of paths over MPI
+     *
+     * The master holds all the paths and hands them out one at a time. The other ranks ask for a new path
+     * whenever they finish the previous one, so a slow path only delays the rank that got it.
+     * The master works on the queue as well. When MPI allows serialized calls from several threads, the master answers requests
+     * from a thread of its own, so that workers are not held up while the master is busy. The master must then make no other MPI calls
+     * until finish(). Otherwise it answers with nonblocking messages whenever it calls serve() or next(), so it should call serve()
+     * regularly while working on a path.
+     * An empty reply tells a worker that the queue is exhausted.
+     */
+    class work_queue {
+        private:
+        static constexpr int  tag_request    = 1001;
+        static constexpr int  tag_reply      = 1002;
+        static constexpr auto serve_interval = std::chrono::milliseconds(1); // How often the server thread checks for requests
+
+        int                                            master;
+        std::deque<h5pp::fs::path>                     paths;                          // Only used on the master
+        MPI_Request                                    request     = MPI_REQUEST_NULL; // Pending request from any worker
+        int                                            request_buf = 0;
+        std::list<std::pair<std::string, MPI_Request>> replies;                        // Keeps the reply buffers alive until they are sent
+        int                                            num_stopped = 0;                // Number of workers that have been told to stop
+        std::mutex                                     mutex;                          // Serializes the MPI calls of the master and its server thread
+        std::thread                                    server;                         // Answers requests in the background (master only)
+        std::atomic<bool>                              stopping    = false;
+        void                                           reply(int dst);
+        void                                           post_request();
+        void                                           serve_unlocked(bool wait);
+        void                                           stop_server();
+
+        public:
+        work_queue(const std::vector<h5pp::fs::path> &paths_, int master_ = 0);
+        ~work_queue();
+        work_queue(const work_queue &)            = delete;
+        work_queue &operator=(const work_queue &) = delete;
+
+        void                          serve(bool wait = false); /*!< Answers pending requests (master only). With wait, blocks until every worker has stopped */
+        std::optional<h5pp::fs::path> next();                   /*!< Returns the next path for this rank, or nullopt when the queue is exhausted */
+        void                          finish();                 /*!< Master only: hands out stop messages until every worker is done */
+    };
+}
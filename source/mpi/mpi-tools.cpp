@@ -1,12 +1,14 @@
 
 #include "mpi-tools.h"
+#include <array>
 #include <general/iter.h>
 #include <io/logger.h>
+#include <limits>
 #include <math/num.h>
 #include <mpi/mpi.h>
 void mpi::init() {
-    // Initialize the MPI environment
-    MPI_Init(nullptr, nullptr);
+    // Initialize the MPI environment. Serialized calls from several threads let id 0 serve the work queue from a thread of its own
+    MPI_Init_thread(nullptr, nullptr, MPI_THREAD_SERIALIZED, &thread_level);
     MPI_Comm_rank(MPI_COMM_WORLD, &world.id);   // Establish thread number of this worker
     MPI_Comm_size(MPI_COMM_WORLD, &world.size); // Get total number of threads
 
@@ -29,112 +31,141 @@ void mpi::barrier() {
     if(world.size > 1 or mpi::on) MPI_Barrier(MPI_COMM_WORLD);
 }
 
-void mpi::scatter(std::vector<h5pp::fs::path> &data, int src) {
-    if(world.size == 1) return; // No need to scatter
-
-    // Since the path's are not plain data, we need to mimic the logic of scatter
-    // Every path is constructible from a string, so we can simply send the string data around.
+mpi::packed_strings mpi::pack(const std::vector<std::string> &strs) {
+    packed_strings packed;
+    packed.offsets.reserve(strs.size() + 1);
+    for(const auto &str : strs) packed.push_back(str);
+    return packed;
+}
 
-    // First we need to decide how to split the data into even chunks
-    // First we need to decide how to split the data into even chunks
-    std::vector<size_t> counts(world.get_size<size_t>(), 0);
-    size_t              sum_counts = 0;
-    if(world.id == src) {
-        for(const auto &[i, d] : iter::enumerate(data)) counts[num::mod<size_t>(i, world.get_size<size_t>())] += 1;
-        sum_counts = num::sum(counts);
-        if(sum_counts != data.size()) throw std::runtime_error(h5pp::format("mpi::scatter: counts does not add up: {} = {}", counts, num::sum(counts)));
-    }
-    // Communicate to everyone how many elements they should expect
-    MPI_Bcast(mpi::get_buffer(counts), mpi::get_count(counts), mpi::get_dtype<size_t>(), src, MPI_COMM_WORLD);
-    sum_counts = num::sum(counts);
-
-    // Reserve space to receive data
-    std::vector<h5pp::fs::path> srcData; // Elements to keep in src
-    if(world.id != src)
-        data.reserve(counts[world.get_id<size_t>()]);
-    else
-        srcData.reserve(counts[world.get_id<size_t>()]);
-
-    // Now we can start sending data
-
-    size_t srcidx = 0;
-    for(int dst = 0; dst < world.size; dst++) {
-        if(world.id == src or world.id == dst) {
-            size_t c = counts[static_cast<unsigned long>(dst)];
-            for(size_t dstidx = 0; dstidx < c; dstidx++) {
-                if(world.id == dst and src != dst) {
-                    std::string tmp;
-                    mpi::recv(tmp, src, 0);
-                    data.emplace_back(tmp);
-                } else if(world.id == src) {
-                    if(dst == src) {
-                        srcData.emplace_back(data[srcidx]);
-                    } else
-                        mpi::send(data[srcidx].string(), dst, 0);
-                    srcidx++;
-                }
-            }
-        }
+std::vector<std::string> mpi::unpack(const packed_strings &packed) {
+    std::vector<std::string> strs;
+    strs.reserve(packed.size());
+    for(size_t i = 0; i < packed.size(); i++) strs.emplace_back(packed[i]);
+    return strs;
+}
 
-        MPI_Barrier(MPI_COMM_WORLD);
-    }
-    if(world.id == src) data = srcData; // Now src can let go of the sent data and keep only what corresponds to src
+void mpi::packed_strings::push_back(std::string_view str) {
+    if(chars.size() + str.size() > static_cast<size_t>(std::numeric_limits<int>::max()))
+        throw std::runtime_error(h5pp::format("mpi::packed_strings: too many characters for an MPI message: {}", chars.size() + str.size()));
+    chars.insert(chars.end(), str.begin(), str.end());
+    offsets.emplace_back(static_cast<int>(chars.size()));
+}
 
-    MPI_Barrier(MPI_COMM_WORLD);
-    if(data.size() != counts[world.get_id<size_t>()])
-        throw std::logic_error(h5pp::format("mpi::scatter on id {} failed: counts {} | size {}", world.id, counts, data.size()));
+std::vector<int> mpi::packed_strings::lengths() const {
+    std::vector<int> lens(size());
+    for(size_t i = 0; i < size(); i++) lens[i] = offsets[i + 1] - offsets[i];
+    return lens;
 }
 
-void mpi::scatter_r(std::vector<h5pp::fs::path> &data, int src) {
+void mpi::scatterv(std::vector<std::string> &data, const std::vector<int> &dst, int src) {
     if(world.size == 1) return; // No need to scatter
 
-    // Scatter in roundrobin mode
+    // On src, pack the strings back to back, grouped by destination, so that each destination gets one contiguous piece.
+    // Then every id learns how many strings and characters to expect, and receives the string lengths and the characters
+    // in one MPI_Scatterv each.
+    packed_strings   packed;
+    std::vector<int> meta;                                           // Number of strings and characters for each id
+    std::vector<int> str_counts, str_displs, chr_counts, chr_displs; // Arguments for MPI_Scatterv, only used on src
+    if(world.id == src) {
+        if(dst.size() != data.size()) throw std::runtime_error(h5pp::format("mpi::scatterv: dst size {} != data size {}", dst.size(), data.size()));
+        str_counts.resize(world.get_size<size_t>(), 0);
+        chr_counts.resize(world.get_size<size_t>(), 0);
+        str_displs.resize(world.get_size<size_t>(), 0);
+        chr_displs.resize(world.get_size<size_t>(), 0);
+        std::vector<std::vector<size_t>> indices(world.get_size<size_t>()); // Indices into data for each id, in order
+        for(const auto &[i, d] : iter::enumerate(dst)) {
+            if(d < 0 or d >= world.size) throw std::runtime_error(h5pp::format("mpi::scatterv: invalid destination id {}", d));
+            indices[static_cast<size_t>(d)].emplace_back(i);
+        }
+        for(int id = 0; id < world.size; id++) {
+            str_displs[static_cast<size_t>(id)] = static_cast<int>(packed.size());
+            chr_displs[static_cast<size_t>(id)] = static_cast<int>(packed.chars.size());
+            for(const auto &i : indices[static_cast<size_t>(id)]) packed.push_back(data[i]);
+            str_counts[static_cast<size_t>(id)] = static_cast<int>(packed.size()) - str_displs[static_cast<size_t>(id)];
+            chr_counts[static_cast<size_t>(id)] = static_cast<int>(packed.chars.size()) - chr_displs[static_cast<size_t>(id)];
+            meta.emplace_back(str_counts[static_cast<size_t>(id)]);
+            meta.emplace_back(chr_counts[static_cast<size_t>(id)]);
+        }
+    }
+    std::array<int, 2> counts = {0, 0};
+    MPI_Scatter(meta.data(), 2, MPI_INT, counts.data(), 2, MPI_INT, src, MPI_COMM_WORLD);
+
+    auto             src_lengths = packed.lengths();
+    std::vector<int> lengths(static_cast<size_t>(counts[0]));
+    MPI_Scatterv(src_lengths.data(), str_counts.data(), str_displs.data(), MPI_INT, lengths.data(), counts[0], MPI_INT, src, MPI_COMM_WORLD);
+
+    packed_strings received;
+    received.chars.resize(static_cast<size_t>(counts[1]));
+    MPI_Scatterv(packed.chars.data(), chr_counts.data(), chr_displs.data(), MPI_CHAR, received.chars.data(), counts[1], MPI_CHAR, src,
+                 MPI_COMM_WORLD);
+    for(const auto &len : lengths) received.offsets.emplace_back(received.offsets.back() + len);
+    if(received.offsets.back() != counts[1])
+        throw std::logic_error(h5pp::format("mpi::scatterv on id {} failed: lengths add up to {} | expected {}", world.id, received.offsets.back(), counts[1]));
+    data = unpack(received);
+}
 
-    // Since the path's are not plain data, we need to mimic the logic of scatter
-    // Every path is constructible from a string, so we can simply send the string data around.
+void mpi::scatter(std::vector<h5pp::fs::path> &data, const std::vector<int> &dst, int src) {
+    if(world.size == 1) return; // No need to scatter
+    // Every path is constructible from a string, so we can simply send the strings around.
+    std::vector<std::string> strs;
+    strs.reserve(data.size());
+    for(const auto &d : data) strs.emplace_back(d.string());
+    scatterv(strs, dst, src);
+    data = std::vector<h5pp::fs::path>(strs.begin(), strs.end());
+}
 
-    // First we need to decide how to split the data into even chunks
-    std::vector<size_t> counts(world.get_size<size_t>(), 0);
-    size_t              sum_counts = 0;
+void mpi::scatter(std::vector<h5pp::fs::path> &data, int src) {
+    if(world.size == 1) return; // No need to scatter
+    // Split the data into contiguous chunks of even size
+    std::vector<int> dst;
     if(world.id == src) {
+        std::vector<size_t> counts(world.get_size<size_t>(), 0);
         for(const auto &[i, d] : iter::enumerate(data)) counts[num::mod<size_t>(i, world.get_size<size_t>())] += 1;
-        sum_counts = num::sum(counts);
-        if(sum_counts != data.size()) throw std::runtime_error(h5pp::format("mpi::scatter: counts does not add up: {} = {}", counts, num::sum(counts)));
+        for(const auto &[id, count] : iter::enumerate(counts)) dst.insert(dst.end(), count, static_cast<int>(id));
     }
+    scatter(data, dst, src);
+}
 
-    // Communicate to everyone how many elements they should expect
-    MPI_Bcast(mpi::get_buffer(counts), mpi::get_count(counts), mpi::get_dtype<size_t>(), src, MPI_COMM_WORLD);
-    sum_counts = num::sum(counts);
-
-    // Reserve space to receive data
-    std::vector<h5pp::fs::path> srcData; // Elements to keep in src
-    if(world.id != src)
-        data.reserve(counts[world.get_id<size_t>()]);
-    else
-        srcData.reserve(counts[world.get_id<size_t>()]);
-
-    // Now we can start sending data
-
-    for(size_t srcidx = 0; srcidx < sum_counts; srcidx++) {
-        int dst = num::mod<int>(static_cast<int>(srcidx), world.size); // Roundrobin destination
-        if(world.id == src or world.id == dst) {
-            if(world.id == dst and src != dst) {
-                std::string tmp;
-                mpi::recv(tmp, src, 0);
-                data.emplace_back(tmp);
-            } else if(world.id == src) {
-                if(dst == src) {
-                    srcData.emplace_back(data[srcidx]);
-                } else
-                    mpi::send(data[srcidx].string(), dst, 0);
-            }
-        }
-        MPI_Barrier(MPI_COMM_WORLD);
+void mpi::scatter_r(std::vector<h5pp::fs::path> &data, int src) {
+    if(world.size == 1) return; // No need to scatter
+    // Scatter in roundrobin mode
+    std::vector<int> dst;
+    if(world.id == src) {
+        for(const auto &[i, d] : iter::enumerate(data)) dst.emplace_back(num::mod<int>(static_cast<int>(i), world.size));
     }
+    scatter(data, dst, src);
+}
 
-    if(world.id == src) data = srcData; // Now src can let go of the sent data and keep only what corresponds to src
-
-    MPI_Barrier(MPI_COMM_WORLD);
-    if(data.size() != counts[world.get_id<size_t>()])
-        throw std::logic_error(h5pp::format("mpi::scatter on id {} failed: counts {} | size {}", world.id, counts, data.size()));
+void mpi::allgatherv(std::vector<std::string> &data) {
+    if(world.size == 1) return; // Nothing to gather
+    // Every id learns how many strings and characters the others have, then the string lengths and characters are gathered
+    // in one MPI_Allgatherv each, the same way as in scatterv.
+    auto               packed = pack(data);
+    std::array<int, 2> counts = {static_cast<int>(packed.size()), static_cast<int>(packed.chars.size())};
+    std::vector<int>   meta(2 * world.get_size<size_t>());
+    MPI_Allgather(counts.data(), 2, MPI_INT, meta.data(), 2, MPI_INT, MPI_COMM_WORLD);
+
+    std::vector<int> str_counts, str_displs, chr_counts, chr_displs;
+    int              num_strs = 0, num_chars = 0;
+    for(size_t id = 0; id < world.get_size<size_t>(); id++) {
+        str_displs.emplace_back(num_strs);
+        chr_displs.emplace_back(num_chars);
+        str_counts.emplace_back(meta[2 * id + 0]);
+        chr_counts.emplace_back(meta[2 * id + 1]);
+        num_strs += str_counts.back();
+        num_chars += chr_counts.back();
+    }
+    auto             src_lengths = packed.lengths();
+    std::vector<int> lengths(static_cast<size_t>(num_strs));
+    MPI_Allgatherv(src_lengths.data(), counts[0], MPI_INT, lengths.data(), str_counts.data(), str_displs.data(), MPI_INT, MPI_COMM_WORLD);
+
+    packed_strings received;
+    received.chars.resize(static_cast<size_t>(num_chars));
+    MPI_Allgatherv(packed.chars.data(), counts[1], MPI_CHAR, received.chars.data(), chr_counts.data(), chr_displs.data(), MPI_CHAR, MPI_COMM_WORLD);
+    for(const auto &len : lengths) received.offsets.emplace_back(received.offsets.back() + len);
+    if(received.offsets.back() != num_chars)
+        throw std::logic_error(
+            h5pp::format("mpi::allgatherv on id {} failed: lengths add up to {} | expected {}", world.id, received.offsets.back(), num_chars));
+    data = unpack(received);
 }
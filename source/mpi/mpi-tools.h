@@ -6,10 +6,13 @@
 #include <h5pp/details/h5ppFilesystem.h>
 #include <h5pp/details/h5ppFormat.h>
 #include <mpi.h>
+#include <string>
+#include <string_view>
 #include <vector>
 namespace mpi {
 
-    inline bool on = false;
+    inline bool on           = false;
+    inline int  thread_level = MPI_THREAD_SINGLE; // The thread support provided by MPI_Init_thread
 
     struct comm {
         int id   = 0;
@@ -140,6 +143,22 @@ namespace mpi {
         MPI_Sendrecv_replace(mpi::get_buffer(data), mpi::get_count(data), mpi::get_dtype<T>(), dst, tag, src, tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
     }
 
+    /*! \brief Strings stored back to back in one contiguous buffer, so that many of them fit in a single MPI message */
+    struct packed_strings {
+        std::vector<char> chars;
+        std::vector<int>  offsets = {0}; // String i is chars[offsets[i], offsets[i+1])
+
+        void                           push_back(std::string_view str);
+        [[nodiscard]] size_t           size() const { return offsets.size() - 1; }
+        [[nodiscard]] std::string_view operator[](size_t i) const { return {chars.data() + offsets[i], static_cast<size_t>(offsets[i + 1] - offsets[i])}; }
+        [[nodiscard]] std::vector<int> lengths() const;
+    };
+    [[nodiscard]] packed_strings           pack(const std::vector<std::string> &strs);
+    [[nodiscard]] std::vector<std::string> unpack(const packed_strings &packed);
+
+    void scatterv(std::vector<std::string> &data, const std::vector<int> &dstIds, int srcId); // data[i] goes to dstIds[i]
     void scatter(std::vector<h5pp::fs::path> &data, int srcId);
-    void scatter_r(std::vector<h5pp::fs::path> &data, int srcId); // Roundrobin
+    void scatter_r(std::vector<h5pp::fs::path> &data, int srcId);                            // Roundrobin
+    void scatter(std::vector<h5pp::fs::path> &data, const std::vector<int> &dstIds, int srcId); // data[i] goes to dstIds[i]
+    void allgatherv(std::vector<std::string> &data);                                          // Concatenates data from all ids, in order of id
 }
\ No newline at end of file